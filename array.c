@@ -29,7 +29,7 @@ array_insert(struct array *arrayay, size_t pos, void *value)
 {
 	size_t len = array_length(arrayay);
 	size_t sz = arrayay->sz;
-	void *insert, *elem;
+	char *insert;
 
 	assert(arrayay->init == 1);
 	assert(pos <= array_length(arrayay));
@@ -38,9 +38,7 @@ array_insert(struct array *arrayay, size_t pos, void *value)
 		return -1;
 
 	insert = (char *)arrayay->mem + pos * sz;
-	elem = (char *)arrayay->mem + (len - 1) * sz;
-	for (; elem >= insert; elem = (char *)elem - sz)
-		memcpy((char *)elem + sz, elem, sz);
+	memmove(insert + sz, insert, (len - pos) * sz);
 	memcpy(insert, value, sz);
 	return 0;
 }
@@ -53,21 +51,35 @@ array_append(struct array *arrayay, void *value)
 	return array_insert(arrayay, array_length(arrayay), value);
 }
 
+int
+array_concat(struct array *arrayay, struct array *other)
+{
+	size_t len = array_length(arrayay);
+	size_t add = array_length(other);
+
+	assert(arrayay->init == 1);
+	assert(arrayay->sz == other->sz);
+
+	if (mem_grow(&arrayay->mem, add * arrayay->sz) < 0)
+		return -1;
+	memcpy((char *)arrayay->mem + len * arrayay->sz, other->mem,
+	  add * arrayay->sz);
+	return 0;
+}
+
 int
 array_delete(struct array *arrayay, size_t pos)
 {
 	size_t sz = arrayay->sz;
-	size_t len = array_length(arrayay->mem);
-	char *delete, *end, *elem;
+	size_t len = array_length(arrayay);
+	char *delete;
 
 	assert(arrayay->init == 1);
 	assert(pos < array_length(arrayay));
 
 	delete = (char *)arrayay->mem + pos * sz;
-	end = (char *)arrayay->mem + len * sz;
-	for (elem = delete; elem < end; elem = (char *)elem + sz)
-		memcpy(elem, (char *)elem + sz, sz);
-	return mem_shrink(arrayay->mem, arrayay->sz);
+	memmove(delete, delete + sz, (len - pos - 1) * sz);
+	return mem_shrink(&arrayay->mem, arrayay->sz);
 }
 
 int
@@ -17,6 +17,7 @@ size_t array_length(struct array *arrayay);
 void * array_i(struct array *arrayay, size_t pos);
 int array_insert(struct array *arrayay, size_t pos, void *value);
 int array_append(struct array *arrayay, void *value);
+int array_concat(struct array *arrayay, struct array *other);
 int array_delete(struct array *arrayay, size_t pos);
 int array_init(struct array *arrayay, size_t sz, struct mem_pool *pool);
 
@@ -0,0 +1,60 @@
+#!/bin/sh -e
+# Compare the time taken by the layout built into netini-dot with Graphviz
+# on generated topologies of growing size: ./bench-layout.sh [sites...]
+
+generate()
+{
+	awk -v sites="$1" 'BEGIN {
+		srand(1)
+		for (s = 0; s < sites; s++) {
+			a = int(s / 250) + 1; b = s % 250
+			printf("[net]\nname = site%d-wan\nip = 92.%d.%d.0/30\n\n", s, a, b)
+			for (v = 0; v < 3; v++)
+				printf("[net]\nname = site%d-lan%d\nip = 10.%d.%d.%d/26\nvlan = %d\n\n",
+				  s, v, a, b, v * 64, 10 + v)
+			printf("[host]\nname = site%d-router-1\nip = 92.%d.%d.1\n", s, a, b)
+			for (v = 0; v < 3; v++)
+				printf("ip = 10.%d.%d.%d\n", a, b, v * 64 + 1)
+			printf("\n[host]\nname = site%d-switch-1\nip = 10.%d.%d.2\n", s, a, b)
+			printf("link = site%d-router-1\n", s)
+			for (w = 0; w < 20; w++)
+				mac[w] = sprintf("00:%02x:%02x:%02x:%02x:%02x", a, b, w,
+				  int(rand() * 256), int(rand() * 256))
+			for (w = 0; w < 10; w++)
+				printf("link = %s\n", mac[w])
+			for (w = 0; w < 20; w++)
+				printf("\n[host]\nname = site%d-ws-%d\nip = 10.%d.%d.%d\nmac = %s\n",
+				  s, w, a, b, (w % 3) * 64 + 10 + w, mac[w])
+			if (s % 10 == 1)
+				printf("\n[ipsec]\nhost = site%d-router-1\nhost = site%d-router-1\n",
+				  s, s - 1)
+			printf("\n")
+		}
+	}'
+}
+
+seconds()
+{
+	start=$(date +%s.%N)
+	"$@" >/dev/null 2>&1 || echo >&2 "failed: $*"
+	awk -v beg="$start" -v end="$(date +%s.%N)" \
+	  'BEGIN { printf("%.2f", end - beg) }'
+}
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+for sites in ${@:-10 100 1000 2000}; do
+	generate "$sites" >"$tmp/in.ini"
+	nodes=$((sites * 26))
+
+	printf 'sites=%d nodes=%d netini-dot-svg=%s' "$sites" "$nodes" \
+	  "$(seconds ./netini-dot -l name -T svg "$tmp/in.ini")"
+
+	if command -v twopi >/dev/null; then
+		./netini-dot -l name "$tmp/in.ini" >"$tmp/in.dot"
+		printf ' twopi=%s' "$(seconds twopi -Tsvg "$tmp/in.dot")"
+		printf ' neato=%s' "$(seconds neato -Tsvg "$tmp/in.dot")"
+	fi
+	echo
+done
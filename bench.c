@@ -0,0 +1,214 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "conf.h"
+#include "ip.h"
+#include "log.h"
+#include "mac.h"
+#include "mem.h"
+
+/*
+ * Throughput of the parsers on a fixed corpus generated in memory, in MB/s.
+ * Given a baseline file of "name minimum" lines, fail if any of the
+ * measures falls below its minimum.
+ */
+
+#define BENCH_RUNS 5
+#define BENCH_HOSTS 100000
+
+struct bench {
+	char const *name;
+	double (*fn)(char *buf, size_t sz);
+	uintmax_t mbps;
+};
+
+static char *corpus_conf, *corpus_ip, *corpus_mac;
+static size_t corpus_conf_sz, corpus_ip_sz, corpus_mac_sz;
+
+static uint32_t
+bench_rand(void)
+{
+	static uint32_t seed = 1;
+
+	/* fixed LCG rather than rand() for the corpus to be the same anywhere */
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static FILE *
+bench_corpus(char **buf, size_t *sz)
+{
+	FILE *fp;
+
+	if ((fp = open_memstream(buf, sz)) == NULL)
+		die("msg=","generating corpus");
+	return fp;
+}
+
+static void
+bench_generate(void)
+{
+	FILE *conf, *ip, *mac;
+
+	conf = bench_corpus(&corpus_conf, &corpus_conf_sz);
+	ip = bench_corpus(&corpus_ip, &corpus_ip_sz);
+	mac = bench_corpus(&corpus_mac, &corpus_mac_sz);
+
+	for (int i = 0; i < BENCH_HOSTS; i++) {
+		uint32_t r = bench_rand(), r2 = bench_rand();
+
+		fprintf(conf, "\n[host]\nname = bench-host-%d\n", i);
+		fprintf(conf, "ip = 10.%u.%u.%u\n", r >> 16 & 0xff,
+		  r >> 8 & 0xff, r & 0xff);
+		fprintf(conf, "ip = 2001:db8:%x::%x:%x\n", r >> 16, r & 0xffff,
+		  r2 & 0xffff);
+		fprintf(conf, "mac = 00:%02x:%02x:%02x:%02x:%02x\n",
+		  r >> 16 & 0xff, r >> 8 & 0xff, r & 0xff, r2 >> 8 & 0xff,
+		  r2 & 0xff);
+		fprintf(conf, "link = bench-host-%u\n", r2 % BENCH_HOSTS);
+
+		fprintf(ip, "10.%u.%u.%u\n", r >> 16 & 0xff, r >> 8 & 0xff,
+		  r & 0xff);
+		fprintf(ip, "2001:db8:%x::%x:%x\n", r >> 16, r & 0xffff,
+		  r2 & 0xffff);
+
+		fprintf(mac, "00:%02x:%02x:%02x:%02x:%02x\n", r >> 16 & 0xff,
+		  r >> 8 & 0xff, r & 0xff, r2 >> 8 & 0xff, r2 & 0xff);
+	}
+
+	fclose(conf);
+	fclose(ip);
+	fclose(mac);
+}
+
+static double
+bench_conf(char *buf, size_t sz)
+{
+	struct mem_pool pool = {0};
+	struct conf conf = {0};
+	size_t ln;
+	FILE *fp;
+
+	if ((fp = fmemopen(buf, sz, "r")) == NULL)
+		die("msg=","opening corpus");
+	if (conf_parse_stream(&conf, fp, &ln, &pool) < 0)
+		die("msg=","parsing corpus", "line=",fmt(ln));
+	fclose(fp);
+	mem_free(&pool);
+	return sz;
+}
+
+static double
+bench_lines(char *buf, size_t sz, int is_mac)
+{
+	uint8_t ip[16];
+	char *s, *end = buf + sz, *nl;
+
+	for (s = buf; s < end; s = nl + 1) {
+		nl = memchr(s, '\n', end - s);
+		*nl = '\0';
+		if ((is_mac ? mac_parse_addr(s, ip) : ip_parse_addr(s, ip)) == NULL)
+			die("msg=","parsing corpus", "line=",s);
+		*nl = '\n';
+	}
+	return sz;
+}
+
+static double
+bench_ip(char *buf, size_t sz)
+{
+	return bench_lines(buf, sz, 0);
+}
+
+static double
+bench_mac(char *buf, size_t sz)
+{
+	return bench_lines(buf, sz, 1);
+}
+
+static uintmax_t
+bench_run(struct bench *bench, char *buf, size_t sz)
+{
+	double best = 0;
+
+	for (int i = 0; i < BENCH_RUNS; i++) {
+		struct timespec beg, end;
+		double bytes, sec;
+
+		clock_gettime(CLOCK_MONOTONIC, &beg);
+		bytes = bench->fn(buf, sz);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		sec = (end.tv_sec - beg.tv_sec) + (end.tv_nsec - beg.tv_nsec) / 1e9;
+		if (bytes / sec > best)
+			best = bytes / sec;
+	}
+	return best / 1e6;
+}
+
+static int
+bench_check(struct bench *benchs, char const *path)
+{
+	char line[256], name[64];
+	uintmax_t min;
+	FILE *fp;
+	int failed = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		die("msg=","opening baseline", "path=",path);
+
+	while (fgets(line, sizeof line, fp) != NULL) {
+		struct bench *b;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%63s %ju", name, &min) != 2)
+			die("msg=","invalid baseline line", "path=",path);
+
+		for (b = benchs; b->name != NULL; b++)
+			if (strcmp(b->name, name) == 0)
+				break;
+		if (b->name == NULL)
+			die("msg=","unknown benchmark in baseline", "name=",name);
+
+		if (b->mbps < min) {
+			info("msg=","throughput below baseline", "bench=",b->name,
+			  "mbps=",fmt(b->mbps), "min=",fmt(min));
+			failed = 1;
+		}
+	}
+	fclose(fp);
+	return failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct bench benchs[] = {
+		{ "conf_parse_stream", bench_conf, 0 },
+		{ "ip_parse_addr", bench_ip, 0 },
+		{ "mac_parse_addr", bench_mac, 0 },
+		{ NULL, NULL, 0 }
+	};
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [baseline]\n", argv[0]);
+		return 1;
+	}
+
+	bench_generate();
+
+	benchs[0].mbps = bench_run(&benchs[0], corpus_conf, corpus_conf_sz);
+	benchs[1].mbps = bench_run(&benchs[1], corpus_ip, corpus_ip_sz);
+	benchs[2].mbps = bench_run(&benchs[2], corpus_mac, corpus_mac_sz);
+
+	for (struct bench *b = benchs; b->name != NULL; b++)
+		fprintf(stdout, "%s %ju\n", b->name, b->mbps);
+
+	if (argc == 2)
+		return bench_check(benchs, argv[1]);
+	return 0;
+}
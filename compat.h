@@ -7,6 +7,7 @@
 int strchomp(char *s);
 size_t strip(char *s);
 size_t strlcpy(char *buf, char const *str, size_t sz);
+long long strtonum(char const *s, long long min, long long max, char const **errstr);
 
 
 #endif
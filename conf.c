@@ -2,15 +2,30 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "array.h"
 #include "compat.h"
+#include "hash.h"
 #include "mem.h"
 
+/* stdio buffer of the pipe from the decompressor */
+#define CONF_PIPE_BUF (1 << 17)
+
+extern char **environ;
+
 /*
  * Parser for config.ini configuration format.
  *
@@ -18,6 +33,7 @@
  *
  *	[section]
  *	case_insensitive = unquoted value #<- included in the value
+ *	# section names and keys are turned to lowercase
  *	there_can_be_spaces_before_and_after = they will be trimmed
  *
  *	[section]
@@ -27,7 +43,35 @@
  *
  *	[section]
  *	# empty sections allowed
+ *
+ *	# sections of another file, parsed once and for all
+ *	include = relative/to/this/file.ini
+ */
+
+/*
+ * Included files are kept parsed for the whole process, in a pool of
+ * their own, so that the sections of a file included from many others
+ * are shared rather than parsed again. They are found by device and
+ * inode, and parsed again if their modification time or size changed.
+ * A file included several times, directly or through another, gives its
+ * sections only once, which conf_include_mark() keeps track of.
  */
+struct conf_fragment {
+	struct conf_key key;
+	struct timespec mtime;
+	off_t size;
+	struct conf conf;
+};
+
+struct conf_cache {
+	pthread_mutex_t mutex;
+	struct mem_pool pool;
+	struct hash fragments; /* struct conf_fragment by struct conf_key */
+};
+
+static struct conf_cache conf_cache = { PTHREAD_MUTEX_INITIALIZER, {0}, {0} };
+
+static int conf_include(struct conf *conf, char *line, size_t ln);
 
 char const *
 conf_strerror(int i)
@@ -51,6 +95,10 @@ conf_strerror(int i)
 		return "variable name must be at least one character long";
 	case CONF_ERR_EXTRA_AFTER_SECTION:
 		return "unexpected data found after section name";
+	case CONF_ERR_DECOMPRESS:
+		return "decompression failed";
+	case CONF_ERR_INCLUDE_CYCLE:
+		return "file including itself";
 	case CONF_ERR_ENUM_END:
 		break;
 	}
@@ -99,6 +147,10 @@ conf_parse_variable(struct conf *conf, char *line, size_t ln)
 		return -CONF_ERR_EMPTY_VARIABLE;
 	*end = '\0';
 
+	/* like for section names, so that keys can be compared as-is */
+	for (char *s = variable.key; s < end; s++)
+		*s = tolower((unsigned char)*s);
+
 	variable.value = eq + 1;
 	variable.value += strspn(variable.value, " \t");
 	variable.ln = ln;
@@ -106,6 +158,7 @@ conf_parse_variable(struct conf *conf, char *line, size_t ln)
 	if (array_append(&conf->current->variables, &variable) < 0)
 		return -CONF_ERR_SYSTEM;
 
+	conf->nvariables++;
 	return 0;
 }
 
@@ -117,11 +170,11 @@ conf_init_section(struct conf_section *section, char *name,
 
 	assert(section->init == 0);
 
-	sz = strlen(name) + 1;
+	sz = sizeof section->name;
 	if (strlcpy(section->name, name, sz) >= sz)
 		return -CONF_ERR_SECTION_NAME_TOO_LONG;
 
-	sz = sizeof section->variables;
+	sz = sizeof(struct conf_variable);
 	if (array_init(&section->variables, sz, pool) < 0)
 		return -CONF_ERR_SYSTEM;
 
@@ -142,7 +195,7 @@ conf_parse_section(struct conf *conf, char *line, size_t ln)
 
 	line++;
 	for (s = line; strchr("]\0", *s) == NULL; s++)
-		*s = tolower(*s);
+		*s = tolower((unsigned char)*s);
 	if (*s != ']')
 		return -CONF_ERR_MISSING_CLOSING_BRACKET;
 	if (s[1] != '\0')
@@ -168,11 +221,13 @@ conf_parse_line(struct conf *conf, char *line, size_t ln)
 {
 	if (*line == '[')
 		return conf_parse_section(conf, line, ln);
+	if (strncasecmp(line, "include", 7) == 0 && strchr(" \t=", line[7]))
+		return conf_include(conf, line, ln);
 	return conf_parse_variable(conf, line, ln);
 }
 
 static int
-conf_getline(char **line, size_t *sz, FILE *fp, size_t *ln)
+conf_getline(char **line, size_t *sz, FILE *fp, size_t *ln, size_t *nbytes)
 {
 	ssize_t r, i;
 
@@ -184,6 +239,7 @@ top:
 		return 0;
 
 	(*ln)++;
+	*nbytes += r;
 
 	if (memchr(*line, '\0', r) != NULL)
 		return -CONF_ERR_NUL_BYTE;
@@ -191,9 +247,9 @@ top:
 	r -= strip(*line);
 	assert(r >= 0);
 
-	i = strspn(*line, " \t");
-	for (ssize_t o = 0; i < r; o++, i++)
-		(*line)[o] = (*line)[i];
+	/* most lines have no indent, and are left in place */
+	if ((i = strspn(*line, " \t")) > 0)
+		memmove(*line, *line + i, r - i + 1);
 
 	if ((*line)[0] == '#' || (*line)[0] == '\0')
 		goto top;
@@ -213,7 +269,7 @@ conf_parse_stream(struct conf *conf, FILE *fp, size_t *ln,
 		return -CONF_ERR_SYSTEM;
 
 	*ln = 0;
-	while ((err = conf_getline(&line, &sz, fp, ln)) > 0) {
+	while ((err = conf_getline(&line, &sz, fp, ln, &conf->nbytes)) > 0) {
 		err = conf_parse_line(conf, line, *ln);
 		if (err < 0)
 			break;
@@ -222,17 +278,522 @@ conf_parse_stream(struct conf *conf, FILE *fp, size_t *ln,
 	return err;
 }
 
+/*
+ * Compressed files are recognized by their magic number, and given to the
+ * gzip(1) or zstd(1) utility whose output is parsed through a pipe, with
+ * no temporary file. Only regular files are checked, as reading the magic
+ * number out of a pipe would take it away from the parser.
+ */
+char const *
+conf_decompressor(int fd)
+{
+	unsigned char magic[4];
+	struct stat st;
+
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+		return NULL;
+	if (pread(fd, magic, sizeof magic, 0) != sizeof magic)
+		return NULL;
+	if (magic[0] == 0x1f && magic[1] == 0x8b)
+		return "gzip";
+	if (memcmp(magic, "\x28\xb5\x2f\xfd", 4) == 0)
+		return "zstd";
+	return NULL;
+}
+
+static int
+conf_parse_compressed(struct conf *conf, int fd, char const *cmd, size_t *ln,
+	struct mem_pool *pool)
+{
+	char *argv[] = { (char *)cmd, "-dc", NULL };
+	posix_spawn_file_actions_t actions;
+	FILE *fp;
+	pid_t pid;
+	int p[2], status, err;
+
+	if (pipe(p) == -1)
+		return -CONF_ERR_SYSTEM;
+	fcntl(p[0], F_SETFD, FD_CLOEXEC);
+	fcntl(p[1], F_SETFD, FD_CLOEXEC);
+
+	if ((err = posix_spawn_file_actions_init(&actions)) == 0) {
+		if ((err = posix_spawn_file_actions_adddup2(&actions, fd, 0)) == 0
+		 && (err = posix_spawn_file_actions_adddup2(&actions, p[1], 1)) == 0)
+			err = posix_spawnp(&pid, cmd, &actions, NULL, argv, environ);
+		posix_spawn_file_actions_destroy(&actions);
+	}
+	close(p[1]);
+	if (err != 0) {
+		close(p[0]);
+		errno = err;
+		return -CONF_ERR_SYSTEM;
+	}
+
+	if ((fp = fdopen(p[0], "r")) == NULL) {
+		close(p[0]);
+		err = -CONF_ERR_SYSTEM;
+	} else {
+		setvbuf(fp, NULL, _IOFBF, CONF_PIPE_BUF);
+		err = conf_parse_stream(conf, fp, ln, pool);
+		fclose(fp);
+	}
+
+	/* an error of the parser might have killed it with SIGPIPE */
+	while (waitpid(pid, &status, 0) == -1)
+		if (errno != EINTR)
+			return -CONF_ERR_SYSTEM;
+	if (err == 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+		err = -CONF_ERR_DECOMPRESS;
+	return err;
+}
+
+/*
+ * Put the file on top of the ones being parsed, unless it is already
+ * there, which would make an endless loop of includes.
+ */
+static int
+conf_enter(struct conf *conf, struct conf_file *file, char const *path,
+	struct stat *st)
+{
+	for (struct conf_file *up = conf->file; up != NULL; up = up->up)
+		if (up->dev == st->st_dev && up->ino == st->st_ino)
+			return -CONF_ERR_INCLUDE_CYCLE;
+
+	/* pipes have no directory to resolve the includes from */
+	file->path = S_ISREG(st->st_mode) ? path : NULL;
+	file->dev = st->st_dev;
+	file->ino = st->st_ino;
+	file->up = conf->file;
+	conf->file = file;
+	return 0;
+}
+
+/*
+ * Parse the file open as fd, which is closed afterward.
+ */
+static int
+conf_parse_fd(struct conf *conf, int fd, size_t *ln, struct mem_pool *pool)
+{
+	char const *cmd;
+	FILE *fp;
+	int err;
+
+	if ((cmd = conf_decompressor(fd)) != NULL) {
+		err = conf_parse_compressed(conf, fd, cmd, ln, pool);
+		close(fd);
+		return err;
+	}
+	if ((fp = fdopen(fd, "r")) == NULL) {
+		close(fd);
+		return -CONF_ERR_SYSTEM;
+	}
+
+	err = conf_parse_stream(conf, fp, ln, pool);
+	fclose(fp);
+	return err;
+}
+
 int
 conf_parse_file(struct conf *conf, char const *path, size_t *ln,
 	struct mem_pool *pool)
+{
+	struct conf_file file;
+	struct stat st;
+	int fd, err;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return -CONF_ERR_SYSTEM;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return -CONF_ERR_SYSTEM;
+	}
+	if ((err = conf_enter(conf, &file, path, &st)) < 0) {
+		close(fd);
+		return err;
+	}
+
+	err = conf_parse_fd(conf, fd, ln, pool);
+	conf->file = file.up;
+	return err;
+}
+
+static int
+conf_parse_memory(struct conf *conf, char *buf, size_t len, size_t *ln,
+	struct mem_pool *pool)
 {
 	FILE *fp;
+	int err;
 
-	fp = fopen(path, "r");
+	/* fmemopen() may refuse an empty buffer */
+	if (len == 0) {
+		*ln = 0;
+		return conf_init(conf, pool);
+	}
+	fp = fmemopen(buf, len, "r");
 	if (fp == NULL)
 		return -CONF_ERR_SYSTEM;
 
-	return conf_parse_stream(conf, fp, ln, pool);
+	err = conf_parse_stream(conf, fp, ln, pool);
+	fclose(fp);
+	return err;
+}
+
+/*
+ * Parse a buffer read from path, which is only used for the includes, and
+ * can be NULL for them to be relative to the current directory.
+ */
+int
+conf_parse_buffer(struct conf *conf, char *buf, size_t len, char const *path,
+	size_t *ln, struct mem_pool *pool)
+{
+	struct conf_file file;
+	struct stat st;
+	int err;
+
+	if (path == NULL)
+		return conf_parse_memory(conf, buf, len, ln, pool);
+
+	if (stat(path, &st) == -1)
+		return -CONF_ERR_SYSTEM;
+	if ((err = conf_enter(conf, &file, path, &st)) < 0)
+		return err;
+
+	err = conf_parse_memory(conf, buf, len, ln, pool);
+	conf->file = file.up;
+	return err;
+}
+
+/*
+ * Get the parsed content of the file at path from the cache, or parse it
+ * and add it, with a pool of its own merged into the one of the cache once
+ * it is complete, so that the lock is not held while parsing, which can
+ * include more files.
+ */
+static struct conf_fragment *
+conf_fragment(struct conf *conf, char const *path, int *err)
+{
+	struct conf_fragment *fragment = NULL;
+	struct mem_pool pool = {0};
+	struct conf_file file;
+	struct conf_key key;
+	struct stat st;
+	void **slot;
+	size_t ln;
+	int fd;
+
+	*err = -CONF_ERR_SYSTEM;
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return NULL;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return NULL;
+	}
+	if ((*err = conf_enter(conf, &file, path, &st)) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	memset(&key, 0, sizeof key);
+	key.dev = st.st_dev;
+	key.ino = st.st_ino;
+
+	pthread_mutex_lock(&conf_cache.mutex);
+	if (conf_cache.fragments.init)
+		fragment = hash_get(&conf_cache.fragments, &key, sizeof key);
+	pthread_mutex_unlock(&conf_cache.mutex);
+
+	if (fragment != NULL && fragment->size == st.st_size
+	 && fragment->mtime.tv_sec == st.st_mtim.tv_sec
+	 && fragment->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+		close(fd);
+		*err = 0;
+		goto end;
+	}
+
+	*err = -CONF_ERR_SYSTEM;
+	if ((fragment = mem_alloc(&pool, sizeof *fragment)) == NULL) {
+		close(fd);
+		goto end;
+	}
+	fragment->key = key;
+	fragment->mtime = st.st_mtim;
+	fragment->size = st.st_size;
+	fragment->conf.file = &file;
+	if ((*err = conf_parse_fd(&fragment->conf, fd, &ln, &pool)) < 0)
+		goto end;
+	fragment->conf.file = NULL;
+	fragment->conf.current = NULL;
+
+	/* a fragment already there is replaced, but stays valid */
+	pthread_mutex_lock(&conf_cache.mutex);
+	*err = -CONF_ERR_SYSTEM;
+	if (conf_cache.fragments.init
+	 || hash_init(&conf_cache.fragments, 16, &conf_cache.pool) == 0) {
+		slot = hash_set(&conf_cache.fragments, &fragment->key, sizeof key);
+		if (slot != NULL) {
+			*slot = fragment;
+			mem_pool_merge(&conf_cache.pool, &pool);
+			fragment->conf.pool = &conf_cache.pool;
+			*err = 0;
+		}
+	}
+	pthread_mutex_unlock(&conf_cache.mutex);
+end:
+	if (*err < 0) {
+		mem_free(&pool);
+		fragment = NULL;
+	}
+	conf->file = file.up;
+	return fragment;
+}
+
+/*
+ * Add the sections of the file given by an "include = path" line, relative
+ * to the directory of the current file. They end the current section, and
+ * get the line of the include as their own.
+ */
+static int
+conf_include(struct conf *conf, char *line, size_t ln)
+{
+	struct conf_fragment *fragment;
+	char const *slash;
+	char *path, *s;
+	size_t n;
+	int err;
+
+	assert(conf->init == 1);
+
+	s = line + 7;
+	s += strspn(s, " \t");
+	if (*s++ != '=')
+		return -CONF_ERR_MISSING_EQUAL;
+	s += strspn(s, " \t");
+
+	slash = (*s == '/' || conf->file == NULL || conf->file->path == NULL)
+	  ? NULL : strrchr(conf->file->path, '/');
+	if (slash == NULL) {
+		fragment = conf_fragment(conf, s, &err);
+	} else {
+		n = slash - conf->file->path + 1;
+		if ((path = malloc(n + strlen(s) + 1)) == NULL)
+			return -CONF_ERR_SYSTEM;
+		memcpy(path, conf->file->path, n);
+		strcpy(path + n, s);
+		fragment = conf_fragment(conf, path, &err);
+		free(path);
+	}
+	if (fragment == NULL)
+		return err;
+
+	/* the files included already, directly or not, are left out */
+	n = array_length(&conf->sections);
+	for (size_t i = 0; i < array_length(&fragment->conf.sections); i++) {
+		struct conf_section section;
+
+		section = *(struct conf_section *)array_i(&fragment->conf.sections, i);
+		if (!section.included)
+			section.from = fragment->key;
+		section.included = 1;
+		section.ln = ln;
+		if (conf_include_seen(&conf->included, &section))
+			continue;
+		if (array_append(&conf->sections, &section) < 0)
+			return -CONF_ERR_SYSTEM;
+		conf->nvariables += array_length(&section.variables);
+	}
+	if (conf_include_mark(&conf->included, &conf->sections, n, conf->pool) < 0)
+		return -CONF_ERR_SYSTEM;
+	conf->current = NULL;
+	return 0;
+}
+
+/*
+ * Parallel parsing of one large file: it is mapped in memory and cut into
+ * one chunk per thread, each starting at a line beginning with '[' as
+ * sections cannot span over two chunks. Every chunk is parsed as a stream
+ * into its own struct conf and mem_pool, and then their sections are put
+ * one after the other, with the line numbers moved past the previous
+ * chunks, and the pools merged into the one of the caller.
+ */
+struct conf_chunk {
+	char *buf;
+	size_t len;
+	struct conf conf;
+	struct mem_pool pool;
+	size_t ln; /* lines of the chunk, or line of the error */
+	int err;
+};
+
+static void *
+conf_parse_chunk(void *v)
+{
+	struct conf_chunk *chunk = v;
+
+	chunk->err = conf_parse_memory(&chunk->conf, chunk->buf, chunk->len,
+	  &chunk->ln, &chunk->pool);
+	return NULL;
+}
+
+/*
+ * Put the sections of the chunk after the ones of conf, with the line
+ * numbers starting after base.
+ */
+static int
+conf_stitch(struct conf *conf, struct conf_chunk *chunk, size_t base)
+{
+	struct array *sections = &chunk->conf.sections;
+	size_t n;
+
+	for (size_t i = 0; i < array_length(sections); i++) {
+		struct conf_section *section = array_i(sections, i);
+
+		section->ln += base;
+		section->variables.pool = conf->pool;
+		if (section->included)
+			continue;
+		for (size_t i2 = 0; i2 < array_length(&section->variables); i2++) {
+			struct conf_variable *var = array_i(&section->variables, i2);
+
+			var->ln += base;
+		}
+	}
+	n = array_length(&conf->sections);
+	if (!chunk->conf.included.init) {
+		if (array_concat(&conf->sections, sections) < 0)
+			return -CONF_ERR_SYSTEM;
+		conf->nvariables += chunk->conf.nvariables;
+	} else {
+		/* the files included by an earlier chunk already */
+		for (size_t i = 0; i < array_length(sections); i++) {
+			struct conf_section *section = array_i(sections, i);
+
+			if (conf_include_seen(&conf->included, section))
+				continue;
+			if (array_append(&conf->sections, section) < 0)
+				return -CONF_ERR_SYSTEM;
+			conf->nvariables += array_length(&section->variables);
+		}
+		if (conf_include_mark(&conf->included, &conf->sections, n,
+		  conf->pool) < 0)
+			return -CONF_ERR_SYSTEM;
+	}
+	mem_delete(sections->mem);
+	mem_pool_merge(conf->pool, &chunk->pool);
+
+	conf->nbytes += chunk->conf.nbytes;
+	return 0;
+}
+
+int
+conf_parse_file_parallel(struct conf *conf, char const *path, int nthreads,
+	size_t *ln, struct mem_pool *pool)
+{
+	struct conf_chunk *chunks = NULL;
+	struct conf_file file;
+	struct stat st;
+	pthread_t *threads = NULL;
+	int *started = NULL;
+	size_t nchunks, base;
+	char *buf, *end;
+	int fd, err;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return -CONF_ERR_SYSTEM;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return -CONF_ERR_SYSTEM;
+	}
+
+	/* small files, pipes, compressed files are not worth or possible to map */
+	nchunks = S_ISREG(st.st_mode) ? st.st_size / CONF_CHUNK_MIN : 0;
+	if (nchunks > 1 && conf_decompressor(fd) != NULL)
+		nchunks = 0;
+	if (nthreads > 0 && nchunks > (size_t)nthreads)
+		nchunks = nthreads;
+	if (nchunks <= 1) {
+		close(fd);
+		return conf_parse_file(conf, path, ln, pool);
+	}
+
+	buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED)
+		return -CONF_ERR_SYSTEM;
+	posix_madvise(buf, st.st_size, POSIX_MADV_SEQUENTIAL);
+	end = buf + st.st_size;
+
+	if ((err = conf_enter(conf, &file, path, &st)) < 0) {
+		munmap(buf, st.st_size);
+		return err;
+	}
+	err = -CONF_ERR_SYSTEM;
+	if (conf_init(conf, pool) < 0)
+		goto end;
+	chunks = mem_alloc(pool, nchunks * sizeof *chunks);
+	threads = mem_alloc(pool, nchunks * sizeof *threads);
+	started = mem_alloc(pool, nchunks * sizeof *started);
+	if (chunks == NULL || threads == NULL || started == NULL)
+		goto end;
+
+	for (size_t i = 0; i < nchunks; i++) {
+		char *beg = (i == 0) ? buf : chunks[i - 1].buf + chunks[i - 1].len;
+		char *s = buf + st.st_size / nchunks * (i + 1);
+
+		if (i == nchunks - 1 || s <= beg) {
+			s = end;
+		} else {
+			/* move the cut to the next line starting a section */
+			for (s--; (s = memchr(s, '\n', end - s)) != NULL;)
+				if (++s == end || *s == '[')
+					break;
+			if (s == NULL)
+				s = end;
+		}
+		chunks[i].buf = beg;
+		chunks[i].len = s - beg;
+		chunks[i].conf.file = conf->file;
+	}
+
+	/* the chunks of threads that fail to start are parsed here */
+	for (size_t i = 1; i < nchunks; i++)
+		started[i] = chunks[i].len > 0
+		  && pthread_create(&threads[i], NULL, conf_parse_chunk, &chunks[i]) == 0;
+	conf_parse_chunk(&chunks[0]);
+	for (size_t i = 1; i < nchunks; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else if (chunks[i].len > 0)
+			conf_parse_chunk(&chunks[i]);
+	}
+
+	err = 0;
+	base = 0;
+	for (size_t i = 0; i < nchunks; i++) {
+		if (chunks[i].len == 0)
+			continue;
+		if (err == 0 && (err = chunks[i].err) < 0)
+			*ln = base + chunks[i].ln;
+		if (err == 0 && (err = conf_stitch(conf, &chunks[i], base)) < 0)
+			*ln = base;
+		base += chunks[i].ln;
+		mem_free(&chunks[i].pool);
+	}
+	if (err == 0) {
+		*ln = base;
+		if (array_length(&conf->sections) > 0)
+			conf->current = array_i(&conf->sections,
+			  array_length(&conf->sections) - 1);
+	}
+end:
+	if (chunks != NULL)
+		mem_delete(chunks);
+	if (threads != NULL)
+		mem_delete(threads);
+	if (started != NULL)
+		mem_delete(started);
+	munmap(buf, st.st_size);
+	conf->file = file.up;
+	return err;
 }
 
 struct conf_section *
@@ -313,9 +874,48 @@ conf_dump(struct conf *conf, FILE *fp)
 	struct conf_section *section;
 
 	for (size_t i = 0; (section = conf_next_section(conf, &i, NULL));) {
-		if (i > 0)
-			fputc('\n', stdout);
+		if (i > 1)
+			fputc('\n', fp);
 
 		conf_dump_section(section, fp);
 	}
 }
+
+/*
+ * Whether the section comes from a file included in seen already, so that
+ * the same file included from several places is only added once.
+ */
+int
+conf_include_seen(struct hash *seen, struct conf_section *section)
+{
+	return section->included && seen->init
+	  && hash_get(seen, &section->from, sizeof section->from) != NULL;
+}
+
+/*
+ * Add to seen the files of the sections from beg onward, after they were
+ * all added, as a file gives several sections in a row.
+ */
+int
+conf_include_mark(struct hash *seen, struct array *sections, size_t beg,
+	struct mem_pool *pool)
+{
+	for (size_t i = beg; i < array_length(sections); i++) {
+		struct conf_section *section = array_i(sections, i);
+		struct conf_key *key;
+		void **slot;
+
+		if (!section->included || conf_include_seen(seen, section))
+			continue;
+		if (!seen->init && hash_init(seen, 16, pool) < 0)
+			return -1;
+		/* the sections can move, and the keys of the hash cannot */
+		if ((key = mem_alloc(pool, sizeof *key)) == NULL)
+			return -1;
+		memcpy(key, &section->from, sizeof *key);
+		if ((slot = hash_set(seen, key, sizeof *key)) == NULL)
+			return -1;
+		*slot = key;
+	}
+	return 0;
+}
@@ -3,7 +3,10 @@
 
 #include <stdio.h>
 
+#include <sys/types.h>
+
 #include "array.h"
+#include "hash.h"
 #include "mem.h"
 
 enum conf_errno {
@@ -15,6 +18,8 @@ enum conf_errno {
 	CONF_ERR_VARIABLE_BEFORE_SECTION,
 	CONF_ERR_EMPTY_VARIABLE,
 	CONF_ERR_EXTRA_AFTER_SECTION,
+	CONF_ERR_DECOMPRESS,
+	CONF_ERR_INCLUDE_CYCLE,
 	CONF_ERR_ENUM_END,
 };
 
@@ -23,10 +28,29 @@ struct conf {
 	struct mem_pool *pool;
 	struct conf_section *current;
 	struct array sections; /* struct conf_section */
+	size_t nbytes, nvariables;
+	struct conf_file *file; /* file being parsed, NULL if unknown */
+	struct hash included; /* struct conf_key of the files included */
+};
+
+/* file found by device and inode, whatever the path leading to it */
+struct conf_key {
+	dev_t dev;
+	ino_t ino;
+};
+
+/* a file being parsed, and the one including it, to detect include loops */
+struct conf_file {
+	char const *path; /* NULL for pipes and such */
+	dev_t dev;
+	ino_t ino;
+	struct conf_file *up;
 };
 
 struct conf_section {
 	int init;
+	int included; /* variables shared with the include cache */
+	struct conf_key from; /* file included it comes from, if included */
 	size_t ln;
 	char name[64];
 	struct array variables; /* struct conf_variable */
@@ -38,17 +62,25 @@ struct conf_variable {
 	char buf[];
 };
 
+/* smallest part of a file parsed on a thread of its own */
+#define CONF_CHUNK_MIN (1 << 20)
+
 /** src/conf.c **/
 char const * conf_strerror(int i);
 int conf_init(struct conf *conf, struct mem_pool *pool);
 int conf_parse_section(struct conf *conf, char *line, size_t ln);
 int conf_parse_stream(struct conf *conf, FILE *fp, size_t *ln, struct mem_pool *pool);
+char const * conf_decompressor(int fd);
 int conf_parse_file(struct conf *conf, char const *path, size_t *ln, struct mem_pool *pool);
+int conf_parse_buffer(struct conf *conf, char *buf, size_t len, char const *path, size_t *ln, struct mem_pool *pool);
+int conf_parse_file_parallel(struct conf *conf, char const *path, int nthreads, size_t *ln, struct mem_pool *pool);
 struct conf_section * conf_next_section(struct conf *conf, size_t *i, char const *name);
 struct conf_variable * conf_next_variable(struct conf_section *section, size_t *i, char const *key);
 char * conf_next_value(struct conf_section *section, size_t *i, char const *key);
 char const * conf_get_variable(struct conf *conf, char const *s_name, char const *v_name);
 void conf_dump_section(struct conf_section *section, FILE *fp);
 void conf_dump(struct conf *conf, FILE *fp);
+int conf_include_seen(struct hash *seen, struct conf_section *section);
+int conf_include_mark(struct hash *seen, struct array *sections, size_t beg, struct mem_pool *pool);
 
 #endif
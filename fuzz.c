@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "conf.h"
+#include "ip.h"
+#include "mac.h"
+#include "mem.h"
+
+/*
+ * Fuzzing harness, with one target per binary selected at build time:
+ *
+ *	-DFUZZ_CONF		conf_parse_stream()
+ *	-DFUZZ_IP_ADDR		ip_parse_addr()
+ *	-DFUZZ_IP_MASK		ip_parse_mask()
+ *	-DFUZZ_MAC_ADDR		mac_parse_addr()
+ *	-DFUZZ_ARPA		ip_parse_in_addr_arpa() and ip_parse_ip6_arpa()
+ *
+ * With -DFUZZ_LIBFUZZER, only LLVMFuzzerTestOneInput() is provided and
+ * libFuzzer brings main(). Otherwise, main() runs one input read from
+ * stdin, as expected by AFL.
+ */
+
+int LLVMFuzzerTestOneInput(uint8_t const *buf, size_t sz);
+
+#if defined(FUZZ_CONF)
+
+static void
+fuzz(char *s, size_t sz)
+{
+	struct mem_pool pool = {0};
+	struct conf conf = {0};
+	struct conf_section *section;
+	size_t i, ln;
+	FILE *fp;
+
+	if ((fp = fmemopen(s, sz, "r")) == NULL)
+		return;
+	if (conf_parse_stream(&conf, fp, &ln, &pool) == 0) {
+		for (i = 0; (section = conf_next_section(&conf, &i, NULL));) {
+			size_t i2 = 0;
+
+			while (conf_next_variable(section, &i2, NULL) != NULL)
+				continue;
+		}
+	}
+	fclose(fp);
+	mem_free(&pool);
+}
+
+#elif defined(FUZZ_IP_ADDR)
+
+static void
+fuzz(char *s, size_t sz)
+{
+	uint8_t ip[16];
+
+	(void)sz;
+	ip_parse_addr(s, ip);
+}
+
+#elif defined(FUZZ_IP_MASK)
+
+static void
+fuzz(char *s, size_t sz)
+{
+	int mask;
+
+	(void)sz;
+	ip_parse_mask(s, 4, &mask);
+	ip_parse_mask(s, 6, &mask);
+}
+
+#elif defined(FUZZ_MAC_ADDR)
+
+static void
+fuzz(char *s, size_t sz)
+{
+	uint8_t mac[6];
+
+	(void)sz;
+	mac_parse_addr(s, mac);
+}
+
+#elif defined(FUZZ_ARPA)
+
+static void
+fuzz(char *s, size_t sz)
+{
+	uint8_t ip[16];
+	int prefixlen;
+
+	(void)sz;
+	ip_parse_in_addr_arpa(s, ip, &prefixlen);
+	ip_parse_ip6_arpa(s, ip, &prefixlen);
+}
+
+#else
+#error "define one of the FUZZ_* targets"
+#endif
+
+int
+LLVMFuzzerTestOneInput(uint8_t const *buf, size_t sz)
+{
+	char *s;
+
+	/* the parsers expect a nul-terminated string */
+	if ((s = malloc(sz + 1)) == NULL)
+		return 0;
+	memcpy(s, buf, sz);
+	s[sz] = '\0';
+	fuzz(s, sz);
+	free(s);
+	return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+int
+main(void)
+{
+	static uint8_t buf[1 << 16];
+	size_t sz = 0;
+	ssize_t r;
+
+	while (sz < sizeof buf && (r = read(0, buf + sz, sizeof buf - sz)) > 0)
+		sz += r;
+	return LLVMFuzzerTestOneInput(buf, sz);
+}
+
+#endif
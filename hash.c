@@ -0,0 +1,141 @@
+#include "hash.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mem.h"
+
+/* FNV-1a, fast enough for the short keys we have: names, IPs, MACs */
+uint64_t
+hash_sum(void const *key, size_t len)
+{
+	uint8_t const *u8 = key;
+	uint64_t sum = 0xcbf29ce484222325;
+
+	for (size_t i = 0; i < len; i++) {
+		sum ^= u8[i];
+		sum *= 0x100000001b3;
+	}
+	return sum;
+}
+
+static struct hash_entry *
+hash_slot(struct hash_entry *slots, size_t cap, void const *key, size_t len,
+	uint64_t sum)
+{
+	size_t i = sum & (cap - 1);
+
+	for (;; i = (i + 1) & (cap - 1)) {
+		struct hash_entry *entry = slots + i;
+
+		if (entry->key == NULL)
+			return entry;
+		if (entry->sum == sum && entry->len == len
+		 && memcmp(entry->key, key, len) == 0)
+			return entry;
+	}
+}
+
+static int
+hash_grow(struct hash *hash)
+{
+	struct hash_entry *slots;
+	size_t cap = hash->cap * 2;
+
+	slots = mem_alloc(hash->pool, cap * sizeof *slots);
+	if (slots == NULL)
+		return -1;
+
+	for (size_t i = 0; i < hash->cap; i++) {
+		struct hash_entry *old = hash->slots + i;
+
+		if (old->key != NULL)
+			*hash_slot(slots, cap, old->key, old->len, old->sum) = *old;
+	}
+	mem_delete(hash->slots);
+	hash->slots = slots;
+	hash->cap = cap;
+	return 0;
+}
+
+int
+hash_init(struct hash *hash, size_t cap, struct mem_pool *pool)
+{
+	assert(hash->init == 0);
+
+	/* power of two, to compute the position with a mask */
+	for (hash->cap = 16; hash->cap < cap * 2; hash->cap *= 2)
+		continue;
+	hash->slots = mem_alloc(pool, hash->cap * sizeof *hash->slots);
+	if (hash->slots == NULL)
+		return -1;
+	hash->pool = pool;
+	hash->len = 0;
+	hash->init = 1;
+	return 0;
+}
+
+size_t
+hash_length(struct hash *hash)
+{
+	assert(hash->init == 1);
+
+	return hash->len;
+}
+
+void *
+hash_get(struct hash *hash, void const *key, size_t len)
+{
+	struct hash_entry *entry;
+
+	assert(hash->init == 1);
+
+	entry = hash_slot(hash->slots, hash->cap, key, len, hash_sum(key, len));
+	return (entry->key == NULL) ? NULL : entry->value;
+}
+
+/*
+ * Return a pointer to the value associated with the key, after inserting
+ * it with a NULL value if it was not there yet.
+ */
+void **
+hash_set(struct hash *hash, void const *key, size_t len)
+{
+	struct hash_entry *entry;
+	uint64_t sum = hash_sum(key, len);
+
+	assert(hash->init == 1);
+	assert(key != NULL);
+
+	entry = hash_slot(hash->slots, hash->cap, key, len, sum);
+	if (entry->key != NULL)
+		return &entry->value;
+
+	/* keep the load factor under 1/2 */
+	if ((hash->len + 1) * 2 > hash->cap) {
+		if (hash_grow(hash) < 0)
+			return NULL;
+		entry = hash_slot(hash->slots, hash->cap, key, len, sum);
+	}
+	entry->key = key;
+	entry->len = len;
+	entry->sum = sum;
+	entry->value = NULL;
+	hash->len++;
+	return &entry->value;
+}
+
+struct hash_entry *
+hash_next(struct hash *hash, size_t *i)
+{
+	assert(hash->init == 1);
+
+	while (*i < hash->cap) {
+		struct hash_entry *entry = hash->slots + (*i)++;
+
+		if (entry->key != NULL)
+			return entry;
+	}
+	return NULL;
+}
@@ -0,0 +1,38 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mem.h"
+
+/*
+ * Open addressing hash table mapping keys to pointers. The keys are not
+ * copied: they must stay valid as long as the table, which is the case for
+ * everything allocated from the same mem_pool.
+ */
+
+struct hash_entry {
+	void const *key;
+	size_t len;
+	uint64_t sum;
+	void *value;
+};
+
+struct hash {
+	int init;
+	struct mem_pool *pool;
+	size_t len;
+	size_t cap;
+	struct hash_entry *slots;
+};
+
+/** src/hash.c **/
+uint64_t hash_sum(void const *key, size_t len);
+int hash_init(struct hash *hash, size_t cap, struct mem_pool *pool);
+size_t hash_length(struct hash *hash);
+void * hash_get(struct hash *hash, void const *key, size_t len);
+void ** hash_set(struct hash *hash, void const *key, size_t len);
+struct hash_entry * hash_next(struct hash *hash, size_t *i);
+
+#endif
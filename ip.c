@@ -7,72 +7,111 @@
 #include <stdlib.h>
 #include <string.h>
 
+static char const *
+ip_parse_octet(char const *s, uint8_t *u8)
+{
+	unsigned int u = 0;
+	int n;
+
+	for (n = 0; n < 3 && isdigit((unsigned char)s[n]); n++)
+		u = u * 10 + (s[n] - '0');
+	if (n == 0 || isdigit((unsigned char)s[n]) || u > 0xff)
+		return NULL;
+
+	/* leading zeros are ambiguous: octal for some parsers */
+	if (n > 1 && s[0] == '0')
+		return NULL;
+
+	*u8 = u;
+	return s + n;
+}
+
 char const *
 ip_parse_addr_v4(char const *s, uint8_t ip[4])
 {
-	unsigned long ul;
-
-	if (!isdigit(*s) || (ul = strtoul(s, (char **)&s, 10)) > 0xff)
+	if ((s = ip_parse_octet(s, &ip[0])) == NULL)
 		return NULL;
-	ip[0] = ul;
 
 	for (int i = 1; i < 4; i++) {
 		if (*s++ != '.')
 			return NULL;
-
-		if (!isdigit(*s) || (ul = strtoul(s, (char **)&s, 10)) > 0xff)
+		if ((s = ip_parse_octet(s, &ip[i])) == NULL)
 			return NULL;
-		ip[i] = ul;
 	}
-
 	return s;
 }
 
+static int
+ip_hex(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
 char const *
 ip_parse_addr_v6(char const *s, uint8_t ip[16])
 {
 	char const *cp;
-	unsigned long ul;
-	int i = 0, zpos = 0, zfound = 0;
+	int i = 0, zpos = -1;
 
-	if (*s == ':') {
-		s++;
-		ip[i++] = 0;
-		ip[i++] = 0;
+	/* "::" zero compression delimiter at the beginning */
+	if (s[0] == ':') {
+		if (s[1] != ':')
+			return NULL;
+		s += 2;
+		zpos = 0;
+		if (ip_hex(*s) < 0)
+			goto end;
 	}
 
 	while (i < 16) {
-		/* "::" zero compression delimiter */
-		if (*s == ':') {
-			s++;
-			zpos = i;
-			zfound = 1;
-		}
+		unsigned int u = 0;
+		int n, x;
 
-		/* embeddd IPv4 */
-		cp = ip_parse_addr_v4(s, ip + i);
-		if (cp != NULL) {
+		/* embedded IPv4, only allowed as the last 32 bits */
+		if (i <= 12 && (cp = ip_parse_addr_v4(s, ip + i)) != NULL) {
 			i += 4;
 			s = cp;
 			break;
 		}
 
-		/* regular IPv6 */
-		if (!isxdigit(*s) || (ul = strtoul(s, (char**)&s, 16)) > 0xffff)
-			break;
-		ip[i++] = htons(ul) & 0xff;
-		ip[i++] = htons(ul) >> 8;
+		/* regular IPv6 group */
+		for (n = 0; n < 4 && (x = ip_hex(s[n])) >= 0; n++)
+			u = u << 4 | x;
+		if (n == 0 || ip_hex(s[n]) >= 0)
+			return NULL;
+		s += n;
+		ip[i++] = u >> 8;
+		ip[i++] = u & 0xff;
 
-		if (*s++ != ':')
+		if (*s != ':' || i == 16)
 			break;
-	}
+		s++;
 
-	if ((zfound && i == 16) || (!zfound && i != 16))
+		/* "::" zero compression delimiter after a group */
+		if (*s == ':') {
+			if (zpos >= 0)
+				return NULL;
+			s++;
+			zpos = i;
+			if (ip_hex(*s) < 0)
+				break;
+		}
+	}
+end:
+	if ((zpos >= 0 && i == 16) || (zpos < 0 && i != 16))
 		return NULL;
 
 	/* shift everything after "::" to the end */
-	memmove(ip + 16 - (i - zpos), ip + zpos, i - zpos);
-	memset(ip + zpos, 0, 16 - i);
+	if (zpos >= 0) {
+		memmove(ip + 16 - (i - zpos), ip + zpos, i - zpos);
+		memset(ip + zpos, 0, 16 - i);
+	}
 
 	return s;
 }
@@ -103,7 +142,7 @@ ip_parse_mask(char const *s, int version, int *mask)
 	if (*s++ != '/')
 		return NULL;
 
-	if (!isdigit(*s) || (ul = strtoul(s, (char**)&s, 10)) > 128)
+	if (!isdigit((unsigned char)*s) || (ul = strtoul(s, (char**)&s, 10)) > 128)
 		return NULL;
 	*mask = ul;
 
@@ -113,20 +152,24 @@ ip_parse_mask(char const *s, int version, int *mask)
 	return s;
 }
 
+/*
+ * Parse a reverse name such as "4.3.2.10.in-addr.arpa", or a shorter one
+ * for a zone, into a v4-mapped ip and the 128-based prefixlen it covers.
+ */
 char const *
 ip_parse_in_addr_arpa(char const *s, uint8_t *ip, int *prefixlen)
 {
-	uint8_t stack[16];
+	uint8_t stack[4];
 	unsigned long ul;
-	int dots;
+	int n;
 
 	memset(ip, 0, 16);
 
 	/* fill the stack of numbers into stack[] */
-	for (dots = 0; dots < 3; dots++) {
-		if (!isdigit(*s) || (ul = strtoul(s, (char **)&s, 10)) > 255)
+	for (n = 0; n < 4; n++) {
+		if (!isdigit((unsigned char)*s) || (ul = strtoul(s, (char **)&s, 10)) > 255)
 			break;
-		stack[dots] = ul;
+		stack[n] = ul;
 
 		if (*s++ != '.')
 			return NULL;
@@ -134,42 +177,45 @@ ip_parse_in_addr_arpa(char const *s, uint8_t *ip, int *prefixlen)
 	if (strcmp(s, "in-addr.arpa") != 0)
 		return NULL;
 
-	*prefixlen = dots;
+	*prefixlen = 96 + n * 8;
 
-	/* empty the stack of number of stack[] onto (char*)ip */
-	while (dots-- > 0)
-		*ip++ = stack[dots];
+	/* empty the stack of numbers of stack[] onto the IPv4 part of ip */
+	memset(ip + 10, 0xff, 2);
+	for (int i = 0; i < n; i++)
+		ip[12 + i] = stack[n - 1 - i];
 
-	return s;
+	return s + strlen(s);
 }
 
+/*
+ * Same for "b.a.9.8.[...].ip6.arpa", one hexadecimal digit per label.
+ */
 char const *
 ip_parse_ip6_arpa(char const *s, uint8_t *ip, int *prefixlen)
 {
 	uint8_t stack[32];
-	unsigned long ul;
-	int dots = 0;
+	int n;
 
 	memset(ip, 0, 16);
 
-	/* fill the stack of bytes onto ip6[] */
-	for (int dots = 0; dots < 32; dots += 2) {
-		if (!isxdigit(*s) || (ul = strtoul(s, (char **)&s, 16)) > 0xf)
+	/* fill the stack of nibbles into stack[] */
+	for (n = 0; n < 32; n++) {
+		if (!isxdigit((unsigned char)s[0]) || s[1] != '.')
 			break;
-
-		if (*s++ != '.')
-			return NULL;
+		stack[n] = isdigit((unsigned char)s[0]) ? s[0] - '0'
+		  : tolower((unsigned char)s[0]) - 'a' + 10;
+		s += 2;
 	}
 	if (strcmp(s, "ip6.arpa") != 0)
 		return NULL;
 
-	*prefixlen = dots / 2;
+	*prefixlen = n * 4;
 
-	/* empty the stack onto hex as a hexadecimal string */
-	while ((dots -= 2) > 0)
-		*ip++ = (stack[dots / 2]) + (stack[dots / 2 + 1] >> 4);
+	/* empty the stack onto ip, the last nibble first */
+	for (int i = 0; i < n; i++)
+		ip[i / 2] |= stack[n - 1 - i] << (i % 2 ? 0 : 4);
 
-	return s;
+	return s + strlen(s);
 }
 
 int
@@ -188,6 +234,8 @@ ip_match(uint8_t *ip1, uint8_t *ip2, int prefixlen)
 
 	if (memcmp(ip1, ip2, n) != 0)
 		return 0;
+	if (prefixlen % 8 == 0)
+		return 1;
 	mask = 0xff ^ (0xff >> prefixlen % 8);
 	return (ip1[n] & mask) == (ip2[n] & mask);
 }
@@ -198,24 +246,77 @@ ip_cmp(uint8_t *ip1, uint8_t *ip2)
 	return memcmp(ip1, ip2, 16);
 }
 
+/*
+ * Labels of the reverse name of the bits of ip from beg to end, a byte
+ * each for IPv4 and a nibble each for IPv6, the last one first, each
+ * followed by a dot.
+ */
+static char *
+ip_fmt_arpa_labels(char *s, uint8_t *ip, int beg, int end, int version)
+{
+	if (version == 4) {
+		for (int i = end / 8 - 1; i >= beg / 8; i--) {
+			if (ip[i] >= 100)
+				*s++ = '0' + ip[i] / 100;
+			if (ip[i] >= 10)
+				*s++ = '0' + ip[i] / 10 % 10;
+			*s++ = '0' + ip[i] % 10;
+			*s++ = '.';
+		}
+	} else {
+		for (int i = end / 4 - 1; i >= beg / 4; i--) {
+			*s++ = "0123456789abcdef"[ip[i / 2] >> (i % 2 ? 0 : 4) & 0xf];
+			*s++ = '.';
+		}
+	}
+	*s = '\0';
+	return s;
+}
+
 void
 ip_fmt_arpa_v4(char *s, uint8_t *ip)
 {
-	for (int i = 3; i >= 0; i--)
-		s += sprintf(s, "%d.", ip[i]);
-	s += sprintf(s, "in-addr.arpa");
+	s = ip_fmt_arpa_labels(s, ip, 96, 128, 4);
+	strcpy(s, "in-addr.arpa");
 }
 
 void
 ip_fmt_arpa_v6(char *s, uint8_t *ip)
 {
-	int part;
+	s = ip_fmt_arpa_labels(s, ip, 0, 128, 6);
+	strcpy(s, "ip6.arpa");
+}
 
-	for (int bits = 128 - 4; bits >= 0; bits -= 4) {
-		part = ip[bits/8] >> (4 - bits % 8) & 0xf;
-		s += sprintf(s, "%01x.", part);
+/*
+ * Name of the reverse zone of the first mask bits of ip, which for IPv4
+ * must be a multiple of 8 past 96, and for IPv6 a multiple of 4.
+ */
+void
+ip_fmt_arpa_zone(char *s, uint8_t *ip, int mask)
+{
+	if (ip_version(ip) == 4) {
+		s = ip_fmt_arpa_labels(s, ip, 96, mask, 4);
+		strcpy(s, "in-addr.arpa");
+	} else {
+		s = ip_fmt_arpa_labels(s, ip, 0, mask, 6);
+		strcpy(s, "ip6.arpa");
 	}
-	s += sprintf(s, "ip6.arpa");
+}
+
+/*
+ * Name of ip relative to its reverse zone of ip_fmt_arpa_zone(), or "@"
+ * if it is the zone itself.
+ */
+void
+ip_fmt_arpa_label(char *s, uint8_t *ip, int mask)
+{
+	char *end;
+
+	end = ip_fmt_arpa_labels(s, ip, mask, 128, ip_version(ip));
+	if (end == s)
+		strcpy(s, "@");
+	else
+		end[-1] = '\0';
 }
 
 void
@@ -238,14 +339,34 @@ ip_fmt_addr_v4(char *s, uint8_t *ip)
 		s += sprintf(s, first ? "%d" : ".%d", ip[i]);
 }
 
+/*
+ * Canonical text form of RFC 5952: lowercase, no leading zeroes, and the
+ * longest run of two or more zero groups, the first one on ties, as "::".
+ */
 void
 ip_fmt_addr_v6(char *s, uint8_t *ip)
 {
-	uint16_t u16;
+	uint16_t group[8];
+	int beg = -1, len = 0;
+
+	for (int i = 0; i < 8; i++)
+		group[i] = ip[i * 2] << 8 | ip[i * 2 + 1];
 
-	for (int i = 12, first = 1; i < 16; i++, first = 0) {
-		u16 = (ip[i + 1]) + (ip[i] << 16);
-		s += sprintf(s, first ? "%x" : ":%d", u16);
+	for (int i = 0, n; i < 8; i += n + 1) {
+		for (n = 0; i + n < 8 && group[i + n] == 0; n++)
+			continue;
+		if (n > len && n >= 2)
+			beg = i, len = n;
+	}
+
+	*s = '\0';
+	for (int i = 0; i < 8; i++) {
+		if (i == beg) {
+			s += sprintf(s, "::");
+			i += len - 1;
+			continue;
+		}
+		s += sprintf(s, (i == 0 || i == beg + len) ? "%x" : ":%x", group[i]);
 	}
 }
 
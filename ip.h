@@ -18,6 +18,8 @@ int ip_match(uint8_t *ip1, uint8_t *ip2, int prefixlen);
 int ip_cmp(uint8_t *ip1, uint8_t *ip2);
 void ip_fmt_arpa_v4(char *s, uint8_t *ip);
 void ip_fmt_arpa_v6(char *s, uint8_t *ip);
+void ip_fmt_arpa_zone(char *s, uint8_t *ip, int mask);
+void ip_fmt_arpa_label(char *s, uint8_t *ip, int mask);
 void ip_fmt_arpa(char *s, uint8_t *ip);
 void ip_fmt_addr_v4(char *s, uint8_t *ip);
 void ip_fmt_addr_v6(char *s, uint8_t *ip);
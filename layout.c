@@ -0,0 +1,411 @@
+#include "layout.h"
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "array.h"
+#include "mem.h"
+#include "netini.h"
+
+#define LAYOUT_SPACING 80.0 /* ideal length of an edge */
+#define LAYOUT_THETA 0.8 /* Barnes-Hut precision: lower is slower and finer */
+#define LAYOUT_CUTOFF (LAYOUT_SPACING * 10) /* no repulsion farther than that */
+#define QUAD_DEPTH 40 /* below that, overlapping nodes share a leaf */
+#define QUAD_NONE (-1)
+#define LAYOUT_PI 3.14159265358979323846
+#define LAYOUT_GOLDEN 2.39996322972865332 /* golden angle, in radians */
+
+struct quad {
+	double x0, y0, size;
+	double cx, cy, mass;
+	long child[4];
+	int leaf;
+};
+
+struct quadtree {
+	struct quad *quads;
+	long len;
+};
+
+struct layout_job {
+	struct layout *layout;
+	struct quadtree *qt;
+	size_t *first, *adj;
+	double *dx, *dy;
+	size_t beg, end;
+};
+
+int
+layout_init(struct layout *layout, struct netini_graph *graph, uint8_t *shown,
+	struct mem_pool *pool)
+{
+	layout->n = netini_node_count(graph);
+	layout->shown = shown;
+	layout->x = mem_alloc(pool, layout->n * sizeof *layout->x + 1);
+	layout->y = mem_alloc(pool, layout->n * sizeof *layout->y + 1);
+	if (layout->x == NULL || layout->y == NULL)
+		return -1;
+	return 0;
+}
+
+static int
+layout_is_shown(struct layout *layout, size_t node)
+{
+	return layout->shown == NULL || layout->shown[node];
+}
+
+/*
+ * Vogel's sunflower spiral: the k-th point of a disc evenly filled,
+ * without any two points at the same place.
+ */
+static void
+layout_sunflower(double *x, double *y, double cx, double cy, size_t k)
+{
+	double r = LAYOUT_SPACING * 0.6 * sqrt(k + 0.5);
+	double a = k * LAYOUT_GOLDEN;
+
+	*x = cx + r * cos(a);
+	*y = cy + r * sin(a);
+}
+
+/*
+ * Place every net on a spiral going out from the centre, each with the room
+ * its hosts need, and the hosts as a disc around the net they have their
+ * first IP in. The hosts of no net form one more disc, last on the spiral.
+ */
+int
+layout_radial(struct layout *layout, struct netini_graph *graph)
+{
+	struct mem_pool *pool = graph->hosts.pool;
+	size_t nnets = array_length(&graph->nets);
+	size_t *primary, *count;
+	double *cx, *cy, area = 0;
+
+	primary = mem_alloc(pool, layout->n * sizeof *primary + 1);
+	count = mem_alloc(pool, (nnets + 1) * sizeof *count);
+	cx = mem_alloc(pool, (nnets + 1) * sizeof *cx);
+	cy = mem_alloc(pool, (nnets + 1) * sizeof *cy);
+	if (primary == NULL || count == NULL || cx == NULL || cy == NULL)
+		return -1;
+
+	/* the last group, numbered nnets, is for hosts without net */
+	netini_primary_nets(graph, layout->shown, primary);
+	for (size_t i = nnets; i < layout->n; i++)
+		if (primary[i] == NETINI_NONE)
+			primary[i] = nnets;
+	for (size_t i = nnets; i < layout->n; i++)
+		if (layout_is_shown(layout, i))
+			count[primary[i]]++;
+
+	for (size_t i = 0; i <= nnets; i++) {
+		double radius, r;
+
+		if (i < nnets && !layout_is_shown(layout, i))
+			continue;
+		if (i == nnets && count[i] == 0)
+			continue;
+
+		/* the spiral grows by the area of each disc */
+		radius = LAYOUT_SPACING * (1 + 0.6 * sqrt(count[i] + 1));
+		area += LAYOUT_PI * radius * radius * 1.2;
+		r = sqrt(area / LAYOUT_PI) - radius;
+		cx[i] = r * cos(i * LAYOUT_GOLDEN);
+		cy[i] = r * sin(i * LAYOUT_GOLDEN);
+		if (i < nnets) {
+			layout->x[i] = cx[i];
+			layout->y[i] = cy[i];
+		}
+
+		/* reused as the index of the next host of that group */
+		count[i] = 1;
+	}
+
+	for (size_t i = nnets; i < layout->n; i++) {
+		size_t net = primary[i];
+
+		if (layout_is_shown(layout, i))
+			layout_sunflower(&layout->x[i], &layout->y[i],
+			  cx[net], cy[net], count[net]++);
+	}
+
+	mem_delete(primary);
+	mem_delete(count);
+	mem_delete(cx);
+	mem_delete(cy);
+	return 0;
+}
+
+static long
+quad_new(struct quadtree *qt, double x0, double y0, double size)
+{
+	struct quad *quad;
+
+	if ((size_t)(qt->len + 1) * sizeof *quad > mem_length(qt->quads))
+		if (mem_resize((void **)&qt->quads,
+		  (qt->len + 1) * 2 * sizeof *quad) < 0)
+			return QUAD_NONE;
+
+	quad = qt->quads + qt->len;
+	memset(quad, 0, sizeof *quad);
+	quad->x0 = x0;
+	quad->y0 = y0;
+	quad->size = size;
+	quad->leaf = 1;
+	for (int i = 0; i < 4; i++)
+		quad->child[i] = QUAD_NONE;
+	return qt->len++;
+}
+
+static long
+quad_child(struct quadtree *qt, long q, double x, double y)
+{
+	struct quad *quad = qt->quads + q;
+	double half = quad->size / 2;
+	int i = (x >= quad->x0 + half) | (y >= quad->y0 + half) << 1;
+	long c;
+
+	if (quad->child[i] != QUAD_NONE)
+		return quad->child[i];
+
+	c = quad_new(qt, quad->x0 + (i & 1) * half, quad->y0 + (i >> 1) * half,
+	  half);
+	if (c == QUAD_NONE)
+		return QUAD_NONE;
+
+	/* quad_new() might have moved the quads */
+	qt->quads[q].child[i] = c;
+	return c;
+}
+
+static void
+quad_add_mass(struct quad *quad, double x, double y, double mass)
+{
+	quad->cx = (quad->cx * quad->mass + x * mass) / (quad->mass + mass);
+	quad->cy = (quad->cy * quad->mass + y * mass) / (quad->mass + mass);
+	quad->mass += mass;
+}
+
+static int
+quad_insert(struct quadtree *qt, double x, double y)
+{
+	long q = 0, c;
+
+	for (int depth = 0;; depth++) {
+		struct quad *quad = qt->quads + q;
+
+		if (quad->mass == 0) {
+			quad->cx = x;
+			quad->cy = y;
+			quad->mass = 1;
+			return 0;
+		}
+
+		if (quad->leaf && depth < QUAD_DEPTH) {
+			double cx = quad->cx, cy = quad->cy, mass = quad->mass;
+
+			/* move the node already there one level down */
+			quad->leaf = 0;
+			if ((c = quad_child(qt, q, cx, cy)) == QUAD_NONE)
+				return -1;
+			quad_add_mass(qt->quads + c, cx, cy, mass);
+			quad = qt->quads + q;
+		}
+
+		quad_add_mass(quad, x, y, 1);
+		if (quad->leaf)
+			return 0;
+		if ((q = quad_child(qt, q, x, y)) == QUAD_NONE)
+			return -1;
+	}
+}
+
+static int
+quad_build(struct quadtree *qt, struct layout *layout)
+{
+	double xmin = INFINITY, ymin = INFINITY, xmax = -INFINITY, ymax = -INFINITY;
+
+	for (size_t i = 0; i < layout->n; i++) {
+		if (!layout_is_shown(layout, i))
+			continue;
+		xmin = fmin(xmin, layout->x[i]);
+		xmax = fmax(xmax, layout->x[i]);
+		ymin = fmin(ymin, layout->y[i]);
+		ymax = fmax(ymax, layout->y[i]);
+	}
+
+	qt->len = 0;
+	if (quad_new(qt, xmin, ymin, fmax(xmax - xmin, ymax - ymin) + 1) < 0)
+		return -1;
+
+	for (size_t i = 0; i < layout->n; i++)
+		if (layout_is_shown(layout, i))
+			if (quad_insert(qt, layout->x[i], layout->y[i]) < 0)
+				return -1;
+	return 0;
+}
+
+/*
+ * Repulsion of all other nodes on (x, y), from the centre of mass of the
+ * quads far enough, and walking down into those too close. Like in the
+ * grid variant of Fruchterman-Reingold, distant nodes are ignored, which
+ * keeps apart parts of the graph from drifting away from each other.
+ */
+static void
+quad_repulse(struct quadtree *qt, double x, double y, double *dx, double *dy)
+{
+	long stack[QUAD_DEPTH * 4 + 8];
+	int top = 0;
+	double k2 = LAYOUT_SPACING * LAYOUT_SPACING;
+
+	stack[top++] = 0;
+	while (top > 0) {
+		struct quad *quad = qt->quads + stack[--top];
+		double ex = x - quad->cx, ey = y - quad->cy;
+		double d2 = ex * ex + ey * ey;
+
+		if (quad->mass == 0)
+			continue;
+
+		/* far enough from the whole quad to ignore it */
+		if (d2 > (quad->size + LAYOUT_CUTOFF) * (quad->size + LAYOUT_CUTOFF))
+			continue;
+
+		if (quad->leaf || quad->size * quad->size
+		  < LAYOUT_THETA * LAYOUT_THETA * d2) {
+			/* the node itself, or another exactly on it */
+			if (d2 < 1e-9)
+				continue;
+			*dx += ex * k2 * quad->mass / d2;
+			*dy += ey * k2 * quad->mass / d2;
+			continue;
+		}
+
+		for (int i = 0; i < 4; i++)
+			if (quad->child[i] != QUAD_NONE)
+				stack[top++] = quad->child[i];
+	}
+}
+
+static void *
+layout_job(void *arg)
+{
+	struct layout_job *job = arg;
+	struct layout *layout = job->layout;
+
+	for (size_t i = job->beg; i < job->end; i++) {
+		double dx = 0, dy = 0;
+
+		if (!layout_is_shown(layout, i))
+			continue;
+
+		quad_repulse(job->qt, layout->x[i], layout->y[i], &dx, &dy);
+
+		for (size_t a = job->first[i]; a < job->first[i + 1]; a++) {
+			size_t j = job->adj[a];
+			double ex, ey, d;
+
+			if (!layout_is_shown(layout, j))
+				continue;
+			ex = layout->x[i] - layout->x[j];
+			ey = layout->y[i] - layout->y[j];
+			d = sqrt(ex * ex + ey * ey);
+			dx -= ex * d / LAYOUT_SPACING;
+			dy -= ey * d / LAYOUT_SPACING;
+		}
+		job->dx[i] = dx;
+		job->dy[i] = dy;
+	}
+	return NULL;
+}
+
+/*
+ * Fruchterman-Reingold refinement: every step, each node is moved toward
+ * the sum of forces applied to it, by no more than the temperature, which
+ * lowers from step to step. The nodes are split among threads for the
+ * forces computation, the most expensive part.
+ */
+int
+layout_force(struct layout *layout, struct netini_graph *graph, size_t steps,
+	int nthreads)
+{
+	struct mem_pool *pool = graph->hosts.pool;
+	struct quadtree qt = {0};
+	struct layout_job jobs[NETINI_THREADS_MAX];
+	pthread_t threads[NETINI_THREADS_MAX];
+	int started[NETINI_THREADS_MAX];
+	size_t *first = NULL, *adj = NULL;
+	double *dx, *dy, temp0;
+	int err = -1;
+
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > NETINI_THREADS_MAX)
+		nthreads = NETINI_THREADS_MAX;
+
+	dx = mem_alloc(pool, layout->n * sizeof *dx + 1);
+	dy = mem_alloc(pool, layout->n * sizeof *dy + 1);
+	qt.quads = mem_alloc(pool, 1024 * sizeof *qt.quads);
+	if (dx == NULL || dy == NULL || qt.quads == NULL)
+		goto end;
+	if (netini_adjacency(graph, &first, &adj) < 0)
+		goto end;
+
+	for (int t = 0; t < nthreads; t++) {
+		jobs[t].layout = layout;
+		jobs[t].qt = &qt;
+		jobs[t].first = first;
+		jobs[t].adj = adj;
+		jobs[t].dx = dx;
+		jobs[t].dy = dy;
+		jobs[t].beg = layout->n * t / nthreads;
+		jobs[t].end = layout->n * (t + 1) / nthreads;
+	}
+
+	if (quad_build(&qt, layout) < 0)
+		goto end;
+	temp0 = qt.quads[0].size / 20;
+
+	for (size_t step = 0; step < steps; step++) {
+		double temp = temp0 * (1 - (double)step / steps) + 1;
+
+		if (step > 0 && quad_build(&qt, layout) < 0)
+			goto end;
+
+		/* the jobs of threads that fail to start are run here */
+		for (int t = 1; t < nthreads; t++)
+			started[t] = (pthread_create(&threads[t], NULL,
+			  layout_job, &jobs[t]) == 0);
+		layout_job(&jobs[0]);
+		for (int t = 1; t < nthreads; t++) {
+			if (started[t])
+				pthread_join(threads[t], NULL);
+			else
+				layout_job(&jobs[t]);
+		}
+
+		for (size_t i = 0; i < layout->n; i++) {
+			double d = sqrt(dx[i] * dx[i] + dy[i] * dy[i]);
+
+			if (!layout_is_shown(layout, i) || d < 1e-9)
+				continue;
+			layout->x[i] += dx[i] / d * fmin(d, temp);
+			layout->y[i] += dy[i] / d * fmin(d, temp);
+		}
+	}
+	err = 0;
+end:
+	if (first != NULL)
+		mem_delete(first);
+	if (adj != NULL)
+		mem_delete(adj);
+	if (dx != NULL)
+		mem_delete(dx);
+	if (dy != NULL)
+		mem_delete(dy);
+	if (qt.quads != NULL)
+		mem_delete(qt.quads);
+	return err;
+}
@@ -0,0 +1,29 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "netini.h"
+
+/*
+ * Placement of the graph nodes on a plane, to draw it without Graphviz.
+ *
+ * A radial layout puts the nets on a circle and their hosts around them,
+ * then a force-directed refinement moves connected nodes together and
+ * pushes the others apart, with the repulsion approximated by Barnes-Hut
+ * over a quadtree, which brings each step from O(n^2) to O(n log n).
+ */
+
+struct layout {
+	size_t n;
+	double *x, *y;
+	uint8_t *shown; /* NULL if all nodes are placed */
+};
+
+/** src/layout.c **/
+int layout_init(struct layout *layout, struct netini_graph *graph, uint8_t *shown, struct mem_pool *pool);
+int layout_radial(struct layout *layout, struct netini_graph *graph);
+int layout_force(struct layout *layout, struct netini_graph *graph, size_t steps, int nthreads);
+
+#endif
@@ -0,0 +1,444 @@
+#include "load.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "array.h"
+#include "conf.h"
+#include "mem.h"
+
+struct load_file {
+	char const *path;
+	char *buf; /* NULL for files left to the caller */
+	size_t len;
+	int err; /* errno of the failure, 0 if none */
+	int done;
+};
+
+struct load {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct load_file *files;
+	size_t nfiles;
+	size_t next; /* next file for a thread to read */
+	size_t parsed; /* files given to the caller */
+	size_t ahead; /* files read at most past the ones parsed */
+};
+
+/*
+ * Order of the paths of a walk of the tree with each directory sorted, by
+ * comparing them with '/' before any other character.
+ */
+static int
+load_cmp(void const *a, void const *b)
+{
+	unsigned char const *s1 = *(unsigned char * const *)a;
+	unsigned char const *s2 = *(unsigned char * const *)b;
+
+	for (; *s1 == *s2 && *s1 != '\0'; s1++, s2++)
+		continue;
+	if (*s1 == *s2)
+		return 0;
+	if (*s1 == '/' || *s2 == '/')
+		return (*s1 == '/') ? (*s2 == '\0' ? 1 : -1) : (*s1 == '\0' ? -1 : 1);
+	return *s1 - *s2;
+}
+
+/*
+ * Directories are listed by several threads taking them from a shared
+ * stack, to which each pushes the subdirectories it finds. The files are
+ * collected as they come and sorted once all is listed.
+ */
+struct scan {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	char const *pattern;
+	char **dirs; /* stack of directories left to list */
+	size_t ndirs, capdirs;
+	char **files;
+	size_t nfiles, capfiles;
+	size_t busy; /* threads listing a directory */
+	int err; /* errno of the first failure */
+};
+
+static int
+scan_push(char ***list, size_t *n, size_t *cap, char *s)
+{
+	if (*n == *cap) {
+		size_t sz = (*cap == 0) ? 64 : *cap * 2;
+		char **new;
+
+		if ((new = realloc(*list, sz * sizeof **list)) == NULL)
+			return -1;
+		*list = new;
+		*cap = sz;
+	}
+	(*list)[(*n)++] = s;
+	return 0;
+}
+
+/*
+ * List one directory, with the lock released, and then add what was found
+ * with the lock held again.
+ */
+static int
+scan_dir(struct scan *scan, char const *dir)
+{
+	char **dirs = NULL, **files = NULL;
+	size_t ndirs = 0, capdirs = 0, nfiles = 0, capfiles = 0;
+	struct dirent *de;
+	struct stat st;
+	DIR *dp;
+	int err = 0;
+
+	pthread_mutex_unlock(&scan->mutex);
+
+	if ((dp = opendir(dir)) == NULL)
+		err = errno;
+	while (err == 0 && (de = readdir(dp)) != NULL) {
+		size_t len = strlen(dir) + strlen(de->d_name) + 2;
+		char *s;
+
+		if (de->d_name[0] == '.')
+			continue;
+		if ((s = malloc(len)) == NULL) {
+			err = errno;
+			break;
+		}
+		snprintf(s, len, "%s/%s", dir, de->d_name);
+
+		if (lstat(s, &st) == -1) {
+			err = errno;
+		} else if (S_ISDIR(st.st_mode)) {
+			if (scan_push(&dirs, &ndirs, &capdirs, s) == 0)
+				continue;
+			err = errno;
+		} else if (S_ISLNK(st.st_mode) && stat(s, &st) == 0
+		 && S_ISDIR(st.st_mode)) {
+			/* not followed, against loops */
+		} else if (fnmatch(scan->pattern, de->d_name, 0) == 0) {
+			if (scan_push(&files, &nfiles, &capfiles, s) == 0)
+				continue;
+			err = errno;
+		}
+		free(s);
+	}
+	if (dp != NULL)
+		closedir(dp);
+
+	pthread_mutex_lock(&scan->mutex);
+	for (size_t i = 0; i < ndirs; i++) {
+		if (err == 0 && scan_push(&scan->dirs, &scan->ndirs,
+		  &scan->capdirs, dirs[i]) == 0)
+			continue;
+		if (err == 0)
+			err = errno;
+		free(dirs[i]);
+	}
+	for (size_t i = 0; i < nfiles; i++) {
+		if (err == 0 && scan_push(&scan->files, &scan->nfiles,
+		  &scan->capfiles, files[i]) == 0)
+			continue;
+		if (err == 0)
+			err = errno;
+		free(files[i]);
+	}
+	free(dirs);
+	free(files);
+	return err;
+}
+
+static void *
+scan_thread(void *v)
+{
+	struct scan *scan = v;
+
+	pthread_mutex_lock(&scan->mutex);
+	for (;;) {
+		char *dir;
+		int err;
+
+		while (scan->ndirs == 0 && scan->busy > 0 && scan->err == 0)
+			pthread_cond_wait(&scan->cond, &scan->mutex);
+		if (scan->ndirs == 0 || scan->err != 0)
+			break;
+
+		dir = scan->dirs[--scan->ndirs];
+		scan->busy++;
+		err = scan_dir(scan, dir);
+		scan->busy--;
+		if (err != 0 && scan->err == 0)
+			scan->err = err;
+		free(dir);
+		pthread_cond_broadcast(&scan->cond);
+	}
+	pthread_mutex_unlock(&scan->mutex);
+	return NULL;
+}
+
+/*
+ * Append path to paths, or if it is a directory, every file of its tree
+ * whose name matches pattern, listed on nthreads threads, in the order of
+ * a walk with every directory sorted.
+ */
+int
+load_expand(char *path, char const *pattern, int nthreads,
+	struct array *paths, struct mem_pool *pool)
+{
+	struct scan scan = {0};
+	struct stat st;
+	pthread_t threads[LOAD_THREADS_MAX];
+	int nstarted = 0, err = 0;
+	char *dir;
+
+	if (stat(path, &st) == -1 || !S_ISDIR(st.st_mode))
+		return array_append(paths, &path);
+
+	if ((dir = malloc(strlen(path) + 1)) == NULL)
+		return -1;
+	strcpy(dir, path);
+	scan.pattern = pattern;
+	if (scan_push(&scan.dirs, &scan.ndirs, &scan.capdirs, dir) < 0) {
+		free(dir);
+		return -1;
+	}
+	pthread_mutex_init(&scan.mutex, NULL);
+	pthread_cond_init(&scan.cond, NULL);
+
+	if (nthreads > LOAD_THREADS_MAX)
+		nthreads = LOAD_THREADS_MAX;
+	for (int t = 1; t < nthreads; t++)
+		if (pthread_create(&threads[nstarted], NULL, scan_thread, &scan) == 0)
+			nstarted++;
+	scan_thread(&scan);
+	for (int t = 0; t < nstarted; t++)
+		pthread_join(threads[t], NULL);
+
+	if ((err = scan.err) == 0)
+		qsort(scan.files, scan.nfiles, sizeof *scan.files, load_cmp);
+	for (size_t i = 0; i < scan.nfiles; i++) {
+		size_t len = strlen(scan.files[i]) + 1;
+		char *s;
+
+		if (err == 0 && (s = mem_alloc(pool, len)) == NULL)
+			err = errno;
+		if (err == 0) {
+			memcpy(s, scan.files[i], len);
+			if (array_append(paths, &s) < 0)
+				err = errno;
+		}
+		free(scan.files[i]);
+	}
+	for (size_t i = 0; i < scan.ndirs; i++)
+		free(scan.dirs[i]);
+	free(scan.dirs);
+	free(scan.files);
+	pthread_mutex_destroy(&scan.mutex);
+	pthread_cond_destroy(&scan.cond);
+
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+static void
+load_read(struct load_file *file)
+{
+	struct stat st;
+	size_t sz = 0;
+	ssize_t r;
+	int fd;
+
+	if ((fd = open(file->path, O_RDONLY)) == -1)
+		goto err;
+	if (fstat(fd, &st) == -1)
+		goto err;
+	if (S_ISREG(st.st_mode)
+	  && (st.st_size >= LOAD_MAX || conf_decompressor(fd) != NULL)) {
+		close(fd);
+		return;
+	}
+
+	/* the size is only a hint, as pipes and such have none */
+	do {
+		if (file->len == sz) {
+			char *buf;
+
+			sz = (sz == 0) ? (size_t)st.st_size + 1 : sz * 2;
+			if ((buf = realloc(file->buf, sz)) == NULL)
+				goto err;
+			file->buf = buf;
+		}
+		r = read(fd, file->buf + file->len, sz - file->len);
+		if (r == -1 && errno != EINTR)
+			goto err;
+		if (r > 0)
+			file->len += r;
+	} while (r != 0);
+
+	if (file->buf == NULL)
+		file->buf = malloc(1);
+	close(fd);
+	return;
+err:
+	file->err = errno;
+	if (fd != -1)
+		close(fd);
+}
+
+static void *
+load_thread(void *v)
+{
+	struct load *load = v;
+	size_t i;
+
+	pthread_mutex_lock(&load->mutex);
+	for (;;) {
+		while (load->next < load->nfiles
+		 && load->next >= load->parsed + load->ahead)
+			pthread_cond_wait(&load->cond, &load->mutex);
+		if (load->next >= load->nfiles)
+			break;
+		i = load->next++;
+		pthread_mutex_unlock(&load->mutex);
+
+		load_read(&load->files[i]);
+
+		pthread_mutex_lock(&load->mutex);
+		load->files[i].done = 1;
+		pthread_cond_broadcast(&load->cond);
+	}
+	pthread_mutex_unlock(&load->mutex);
+	return NULL;
+}
+
+/*
+ * Call fn on each of the paths in order, with the content of the file, or
+ * a NULL buf for those too large to be read whole. Stop at the first error
+ * of reading, with errno set and -1 returned, or of fn, whose negative
+ * value is returned, and set failed to the position of the file.
+ */
+int
+load_files(struct array *paths, int nthreads, load_fn *fn, void *arg,
+	size_t *failed)
+{
+	struct load load = {0};
+	pthread_t *threads;
+	int nstarted = 0, err = 0;
+
+	load.nfiles = array_length(paths);
+	if (nthreads < 1)
+		nthreads = 1;
+	if ((size_t)nthreads > load.nfiles)
+		nthreads = load.nfiles;
+	load.ahead = nthreads * LOAD_AHEAD;
+
+	load.files = calloc(load.nfiles + 1, sizeof *load.files);
+	threads = calloc(nthreads + 1, sizeof *threads);
+	if (load.files == NULL || threads == NULL) {
+		free(load.files);
+		free(threads);
+		return -1;
+	}
+	for (size_t i = 0; i < load.nfiles; i++)
+		load.files[i].path = *(char **)array_i(paths, i);
+
+	pthread_mutex_init(&load.mutex, NULL);
+	pthread_cond_init(&load.cond, NULL);
+	for (int t = 0; t < nthreads; t++)
+		if (pthread_create(&threads[nstarted], NULL, load_thread, &load) == 0)
+			nstarted++;
+
+	for (size_t i = 0; i < load.nfiles; i++) {
+		struct load_file *file = &load.files[i];
+
+		/* with no thread started, the files are read here */
+		pthread_mutex_lock(&load.mutex);
+		while (nstarted > 0 && !file->done)
+			pthread_cond_wait(&load.cond, &load.mutex);
+		pthread_mutex_unlock(&load.mutex);
+		if (nstarted == 0)
+			load_read(file);
+
+		if (file->err != 0) {
+			errno = file->err;
+			err = -1;
+		} else {
+			err = fn(arg, file->path, file->buf, file->len);
+		}
+		free(file->buf);
+		file->buf = NULL;
+
+		pthread_mutex_lock(&load.mutex);
+		load.parsed = i + 1;
+		if (err < 0) {
+			*failed = i;
+			load.next = load.nfiles;
+		}
+		pthread_cond_broadcast(&load.cond);
+		pthread_mutex_unlock(&load.mutex);
+		if (err < 0)
+			break;
+	}
+
+	for (int t = 0; t < nstarted; t++)
+		pthread_join(threads[t], NULL);
+	for (size_t i = 0; i < load.nfiles; i++)
+		free(load.files[i].buf);
+	pthread_mutex_destroy(&load.mutex);
+	pthread_cond_destroy(&load.cond);
+	free(load.files);
+	free(threads);
+	return err;
+}
+
+/*
+ * Name of a device after the file it was dumped to: its name without
+ * directory or extension, allocated from pool, or NULL on error.
+ */
+char *
+load_name(char const *path, struct mem_pool *pool)
+{
+	char const *s = strrchr(path, '/');
+	size_t len;
+	char *name;
+
+	s = (s == NULL) ? path : s + 1;
+	len = strcspn(s, ".");
+	if ((name = mem_alloc(pool, len + 1)) == NULL)
+		return NULL;
+	memcpy(name, s, len);
+	return name;
+}
+
+/*
+ * Cut s in place into at most max tokens separated by the characters of
+ * sep, and return how many were stored in tok.
+ */
+size_t
+load_split(char *s, char const *sep, char **tok, size_t max)
+{
+	size_t ntok = 0;
+
+	while (ntok < max) {
+		s += strspn(s, sep);
+		if (*s == '\0')
+			break;
+		tok[ntok++] = s;
+		s += strcspn(s, sep);
+		if (*s != '\0')
+			*s++ = '\0';
+	}
+	return ntok;
+}
@@ -0,0 +1,35 @@
+#ifndef LOAD_H
+#define LOAD_H
+
+#include <stddef.h>
+
+#include "array.h"
+#include "conf.h"
+#include "mem.h"
+
+/*
+ * Loading of many input files: a pool of threads reads them whole into
+ * memory a few files ahead, while the caller parses them one by one in
+ * their order, so that the graph stays the same as with a plain loop.
+ */
+
+/*
+ * larger files are left to the caller to map and parse in parallel, and
+ * compressed ones to decompress through a pipe
+ */
+#define LOAD_MAX (2 * CONF_CHUNK_MIN)
+
+/* files read ahead of the parser by each thread */
+#define LOAD_AHEAD 4
+
+#define LOAD_THREADS_MAX 64
+
+typedef int load_fn(void *arg, char const *path, char *buf, size_t len);
+
+/** src/load.c **/
+int load_expand(char *path, char const *pattern, int nthreads, struct array *paths, struct mem_pool *pool);
+int load_files(struct array *paths, int nthreads, load_fn *fn, void *arg, size_t *failed);
+char *load_name(char const *path, struct mem_pool *pool);
+size_t load_split(char *s, char const *sep, char **tok, size_t max);
+
+#endif
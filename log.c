@@ -26,11 +26,19 @@ log_errno(int err)
 char *
 log_num(char *buf, uintmax_t i)
 {
-	char *s = buf;
+	char *s = buf, *e;
 
-	for (; i > 0; i /= 10)
+	do {
 		*s++ = '0' + i % 10;
+	} while ((i /= 10) > 0);
 	*s = '\0';
+
+	/* digits were written from the lowest one: put them back in order */
+	for (e = s - 1, s = buf; s < e; s++, e--) {
+		char c = *s;
+		*s = *e;
+		*e = c;
+	}
 	return buf;
 }
 
@@ -1,6 +1,7 @@
 #include "mac.h"
 
 #include <ctype.h>
+#include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -9,12 +10,12 @@ mac_parse_addr(char const *s, uint8_t mac[6])
 {
 	size_t n = 6;
 
-	while (isxdigit(s[0]) && isxdigit(s[1])) {
+	while (isxdigit((unsigned char)s[0]) && isxdigit((unsigned char)s[1])) {
 		uint8_t c0 = tolower(*s++);
 		uint8_t c1 = tolower(*s++);
 
-		c0 = (c0 <= '9') ? c0 - '0' : c0 - 'a';
-		c1 = (c1 <= '9') ? c1 - '0' : c1 - 'a';
+		c0 = (c0 <= '9') ? c0 - '0' : c0 - 'a' + 10;
+		c1 = (c1 <= '9') ? c1 - '0' : c1 - 'a' + 10;
 
 		*mac++ = (c0 << 4) | c1;
 
@@ -25,5 +26,14 @@ mac_parse_addr(char const *s, uint8_t mac[6])
 			return NULL;
 		s++;
 	}
+	if (n > 0)
+		return NULL;
 	return s;
 }
+
+void
+mac_fmt_addr(char *s, uint8_t const mac[6])
+{
+	sprintf(s, "%02x:%02x:%02x:%02x:%02x:%02x",
+	  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 
+#define MAC_FMT_ADDR_LEN sizeof("00:00:00:00:00:00")
+
 /** src/mac.c **/
 char const * mac_parse_addr(char const *s, uint8_t mac[6]);
+void mac_fmt_addr(char *s, uint8_t const mac[6]);
 
 #endif
@@ -16,6 +16,15 @@ mem_block(void **memp)
 	return block;
 }
 
+static void
+mem_account(struct mem_stats *stats, size_t old_len, size_t new_len)
+{
+	stats->bytes -= old_len;
+	stats->bytes += new_len;
+	if (stats->bytes > stats->peak)
+		stats->peak = stats->bytes;
+}
+
 void *
 mem_alloc(struct mem_pool *pool, size_t len)
 {
@@ -34,6 +43,10 @@ mem_alloc(struct mem_pool *pool, size_t len)
 		pool->head->prev = block;
 	pool->head = block;
 
+	pool->stats.allocs++;
+	pool->stats.blocks++;
+	mem_account(&pool->stats, 0, len);
+
 	return block->buf;
 }
 
@@ -41,7 +54,9 @@ int
 mem_resize(void **memp, size_t len)
 {
 	struct mem_block *block = mem_block(*memp);
+	struct mem_stats *stats = &block->pool->stats;
 	int is_first = (block == block->pool->head);
+	size_t old_len = block->len;
 	int is_same;
 	void *v;
 
@@ -52,10 +67,14 @@ mem_resize(void **memp, size_t len)
 	block = v;
 
 	block->len = len;
+	stats->resizes++;
+	mem_account(stats, old_len, len);
 
 	if (is_same)
 		return 0;
 
+	stats->copied += (old_len < len) ? old_len : len;
+
 	if (block->prev != NULL)
 		block->prev->next = v;
 	if (block->next != NULL)
@@ -125,6 +144,7 @@ mem_read(void **memp, struct mem_pool *pool)
 			return -1;
 	}
 	block = mem_block(mem);
+	mem_account(&pool->stats, block->len, sz);
 	block->len = sz;
 
 	*memp = mem;
@@ -135,7 +155,11 @@ mem_read(void **memp, struct mem_pool *pool)
 void
 mem_delete(void *mem)
 {
-	struct mem_block *block = mem_block(mem);;
+	struct mem_block *block = mem_block(mem);
+	struct mem_stats *stats = &block->pool->stats;
+
+	stats->blocks--;
+	stats->bytes -= block->len;
 
 	if (block == block->pool->head)
 		block->pool->head = block->next;
@@ -157,4 +181,42 @@ mem_free(struct mem_pool *pool)
 		memset(block, 0, sizeof *block);
 		free(block);
 	}
+	pool->head = NULL;
+	pool->stats.blocks = 0;
+	pool->stats.bytes = 0;
+}
+
+/*
+ * Move all the blocks of src to pool, such as for keeping what a thread
+ * allocated from a pool of its own, and leave src empty.
+ */
+void
+mem_pool_merge(struct mem_pool *pool, struct mem_pool *src)
+{
+	struct mem_block *block, *last = NULL;
+
+	for (block = src->head; block != NULL; block = block->next) {
+		block->pool = pool;
+		last = block;
+	}
+	if (last != NULL) {
+		last->next = pool->head;
+		if (pool->head != NULL)
+			pool->head->prev = last;
+		pool->head = src->head;
+	}
+
+	pool->stats.blocks += src->stats.blocks;
+	pool->stats.allocs += src->stats.allocs;
+	pool->stats.resizes += src->stats.resizes;
+	pool->stats.copied += src->stats.copied;
+	mem_account(&pool->stats, 0, src->stats.bytes);
+
+	memset(src, 0, sizeof *src);
+}
+
+void
+mem_pool_stats(struct mem_pool *pool, struct mem_stats *stats)
+{
+	*stats = pool->stats;
 }
@@ -27,14 +27,28 @@
  * This permits the type checker to still work on all operations while
  * providing generic memory management functions for all types of data
  * structures and keep track of each object's length.
+ *
+ * Each pool also accounts for what goes through it, which mem_pool_stats()
+ * exposes for profiling: the counters are updated for every operation, as
+ * they only cost a few additions compared to the underlying malloc call.
  */
 
 #include <stddef.h>
 
 #define MEM_BLOCK_MAGIC "\xcc\x68\x23\xd7\x9b\x7d\x39\xb9"
 
+struct mem_stats {
+	size_t blocks; /* blocks currently allocated */
+	size_t bytes; /* bytes currently allocated, without the headers */
+	size_t peak; /* highest value reached by bytes */
+	size_t allocs; /* calls to mem_alloc() */
+	size_t resizes; /* calls to mem_resize() and its wrappers */
+	size_t copied; /* bytes moved by realloc() within mem_resize() */
+};
+
 struct mem_pool {
 	struct mem_block *head;
+	struct mem_stats stats;
 };
 
 struct mem_block {
@@ -55,5 +69,7 @@ int mem_append(void **memp, void const *buf, size_t len);
 int mem_read(void **memp, struct mem_pool *pool);
 void mem_delete(void *mem);
 void mem_free(struct mem_pool *pool);
+void mem_pool_merge(struct mem_pool *pool, struct mem_pool *src);
+void mem_pool_stats(struct mem_pool *pool, struct mem_stats *stats);
 
 #endif
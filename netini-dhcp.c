@@ -0,0 +1,361 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "hash.h"
+#include "ip.h"
+#include "load.h"
+#include "log.h"
+#include "mac.h"
+#include "mem.h"
+
+/*
+ * Import the leases of ISC dhcpd and dnsmasq as [host] sections. The files
+ * are read a line at a time, and only the latest lease of each MAC is kept,
+ * in a hash table, so that the memory used depends on the number of
+ * clients and not on the size of the files, which dhcpd appends to on
+ * every renewal.
+ */
+
+#define DHCP_NAME_MAX 256
+#define DHCP_TOKENS_MAX 8
+
+static char *arg0;
+static char const *prefix = "dhcp";
+
+struct dhcp_lease {
+	uint8_t mac[6];
+	uint8_t ip[16];
+	int64_t stamp; /* start or expiry, later for the most recent lease */
+	char *name; /* NULL if the client gave none */
+};
+
+struct dhcp_state {
+	struct array leases; /* struct dhcp_lease * */
+	struct hash macs; /* uint8_t mac[6] -> struct dhcp_lease */
+	struct mem_pool *pool;
+};
+
+/* lease of ISC dhcpd being read */
+struct dhcp_block {
+	int depth, open, has_mac;
+	int active; /* in use, rather than free, expired, released... */
+	uint8_t mac[6];
+	uint8_t ip[16];
+	int64_t stamp;
+	char name[DHCP_NAME_MAX];
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-p prefix] [file...]\n", arg0);
+	exit(1);
+}
+
+/* keep the names usable as host names, whatever the clients send */
+static void
+dhcp_clean(char *s)
+{
+	for (; *s != '\0'; s++)
+		if (!isalnum((unsigned char)*s) && *s != '-' && *s != '.'
+		 && *s != '_')
+			*s = '-';
+}
+
+static void
+dhcp_add(struct dhcp_state *state, uint8_t *mac, uint8_t *ip, int64_t stamp,
+	char const *name)
+{
+	struct dhcp_lease *lease;
+	void **slot;
+
+	if ((lease = hash_get(&state->macs, mac, 6)) == NULL) {
+		if ((lease = mem_alloc(state->pool, sizeof *lease)) == NULL
+		 || array_append(&state->leases, &lease) < 0)
+			die("msg=","adding a lease");
+		memcpy(lease->mac, mac, 6);
+		if ((slot = hash_set(&state->macs, lease->mac, 6)) == NULL)
+			die("msg=","adding a lease");
+		*slot = lease;
+	} else if (stamp < lease->stamp) {
+		return;
+	}
+
+	memcpy(lease->ip, ip, 16);
+	lease->stamp = stamp;
+	if (name == NULL || *name == '\0') {
+		if (lease->name != NULL)
+			mem_delete(lease->name);
+		lease->name = NULL;
+	} else if (lease->name == NULL || strcmp(lease->name, name) != 0) {
+		size_t len = strlen(name);
+
+		if (lease->name != NULL)
+			mem_delete(lease->name);
+		if ((lease->name = mem_alloc(state->pool, len + 1)) == NULL)
+			die("msg=","adding a lease");
+		memcpy(lease->name, name, len + 1);
+		dhcp_clean(lease->name);
+	}
+}
+
+/* seconds since the epoch of a date in UTC, by the days of the civil calendar */
+static int64_t
+dhcp_epoch(int y, int m, int d, int hh, int mm, int ss)
+{
+	int64_t era, yoe, doy, doe;
+
+	y -= (m <= 2);
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return ((era * 146097 + doe - 719468) * 24 + hh) * 3600 + mm * 60 + ss;
+}
+
+/*
+ * Statement of a lease of ISC dhcpd, such as:
+ *	starts 4 2026/10/15 12:00:00;
+ *	binding state active;
+ *	hardware ethernet 00:11:22:33:44:55;
+ *	client-hostname "laptop";
+ *
+ * The free and released leases are written with a later start than the
+ * one in use before, and would replace it if they were kept.
+ */
+static void
+dhcp_isc_statement(struct dhcp_block *block, char **tok, size_t ntok,
+	char *line)
+{
+	int y, m, d, hh, mm, ss;
+
+	if (strcmp(tok[0], "hardware") == 0 && ntok > 2) {
+		block->has_mac = mac_parse_addr(tok[2], block->mac) != NULL;
+	} else if (strcmp(tok[0], "binding") == 0 && ntok > 2) {
+		block->active = strcmp(tok[2], "active") == 0
+		  || strcmp(tok[2], "bootp") == 0;
+	} else if (strcmp(tok[0], "starts") == 0 && ntok > 2) {
+		if (strcmp(tok[1], "epoch") == 0)
+			block->stamp = strtoll(tok[2], NULL, 10);
+		else if (ntok > 3 && sscanf(tok[2], "%d/%d/%d", &y, &m, &d) == 3
+		 && sscanf(tok[3], "%d:%d:%d", &hh, &mm, &ss) == 3)
+			block->stamp = dhcp_epoch(y, m, d, hh, mm, ss);
+	} else if (strcmp(tok[0], "client-hostname") == 0) {
+		char *beg = strchr(line, '"'), *end = strrchr(line, '"');
+
+		if (beg != NULL && end > beg)
+			snprintf(block->name, sizeof block->name, "%.*s",
+			  (int)(end - beg - 1), beg + 1);
+	}
+}
+
+/*
+ * Line of dnsmasq: expiry, MAC with an optional hardware type in front,
+ * IP, hostname or "*" and client ID. The IPv6 lines, which have an IAID
+ * instead of the MAC, are left out.
+ */
+static void
+dhcp_dnsmasq_line(struct dhcp_state *state, char **tok, size_t ntok)
+{
+	uint8_t mac[6], ip[16];
+	char const *end;
+	int64_t stamp;
+
+	if (ntok < 4)
+		return;
+	if ((end = mac_parse_addr(tok[1], mac)) == NULL || *end != '\0') {
+		if (strlen(tok[1]) < 3 || tok[1][2] != '-'
+		 || (end = mac_parse_addr(tok[1] + 3, mac)) == NULL || *end != '\0')
+			return;
+	}
+	if ((end = ip_parse_addr(tok[2], ip)) == NULL || *end != '\0')
+		return;
+	stamp = strtoll(tok[0], NULL, 10);
+	if (stamp == 0)
+		stamp = INT64_MAX;
+	dhcp_add(state, mac, ip, stamp, strcmp(tok[3], "*") == 0 ? NULL : tok[3]);
+}
+
+/*
+ * Remove the comment, and count the braces, which can only enclose a lease
+ * or another block of ISC dhcpd.
+ */
+static int
+dhcp_braces(char *s)
+{
+	int quoted = 0, n = 0;
+
+	for (; *s != '\0'; s++) {
+		if (*s == '\\' && s[1] != '\0')
+			s++;
+		else if (*s == '"')
+			quoted = !quoted;
+		else if (quoted)
+			continue;
+		else if (*s == '#')
+			*s = '\0';
+		else if (*s == '{')
+			n++;
+		else if (*s == '}')
+			n--;
+		if (*s == '\0')
+			break;
+	}
+	return n;
+}
+
+static void
+dhcp_line(struct dhcp_state *state, struct dhcp_block *block, char *line)
+{
+	char *tok[DHCP_TOKENS_MAX], copy[DHCP_NAME_MAX * 2];
+	size_t ntok;
+	int braces;
+
+	braces = dhcp_braces(line);
+	snprintf(copy, sizeof copy, "%s", line);
+	ntok = load_split(copy, " \t\r\n;{}", tok, DHCP_TOKENS_MAX);
+
+	if (ntok > 0 && block->depth == 0 && isdigit((unsigned char)tok[0][0])) {
+		dhcp_dnsmasq_line(state, tok, ntok);
+	} else if (ntok > 1 && block->depth == 0 && strcmp(tok[0], "lease") == 0
+	 && ip_parse_addr(tok[1], block->ip) != NULL) {
+		block->open = 1;
+		block->active = 1; /* for the files older than binding states */
+		block->has_mac = 0;
+		block->stamp = 0;
+		block->name[0] = '\0';
+	} else if (ntok > 0 && block->depth == 1 && block->open) {
+		dhcp_isc_statement(block, tok, ntok, line);
+	}
+
+	if ((block->depth += braces) <= 0) {
+		if (block->open && block->active && block->has_mac)
+			dhcp_add(state, block->mac, block->ip, block->stamp,
+			  block->name);
+		block->depth = block->open = 0;
+	}
+}
+
+static void
+dhcp_parse_file(struct dhcp_state *state, char const *path)
+{
+	struct dhcp_block block = {0};
+	char *line = NULL;
+	size_t sz = 0;
+	FILE *fp;
+
+	fp = (strcmp(path, "/dev/stdin") == 0) ? stdin : fopen(path, "r");
+	if (fp == NULL)
+		die("msg=","opening input", "path=",path);
+	while (getline(&line, &sz, fp) > 0)
+		dhcp_line(state, &block, line);
+	if (ferror(fp))
+		die("msg=","reading input", "path=",path);
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+}
+
+static int
+dhcp_lease_cmp(void const *v1, void const *v2)
+{
+	struct dhcp_lease const *a = *(struct dhcp_lease **)v1;
+	struct dhcp_lease const *b = *(struct dhcp_lease **)v2;
+	int i;
+
+	if ((i = memcmp(a->ip, b->ip, 16)) != 0)
+		return i;
+	return memcmp(a->mac, b->mac, 6);
+}
+
+/* name of the lease, with a number after it if another host has it */
+static char *
+dhcp_name(struct hash *names, struct dhcp_lease *lease, struct mem_pool *pool)
+{
+	char buf[DHCP_NAME_MAX + 32], *name;
+	size_t len;
+	void **slot;
+
+	if (lease->name != NULL)
+		snprintf(buf, DHCP_NAME_MAX, "%s", lease->name);
+	else
+		snprintf(buf, DHCP_NAME_MAX, "%s-%02x%02x%02x%02x%02x%02x", prefix,
+		  lease->mac[0], lease->mac[1], lease->mac[2], lease->mac[3],
+		  lease->mac[4], lease->mac[5]);
+	len = strlen(buf);
+	for (int n = 2; hash_get(names, buf, strlen(buf)) != NULL; n++)
+		snprintf(buf + len, sizeof buf - len, "-%d", n);
+
+	len = strlen(buf);
+	if ((name = mem_alloc(pool, len + 1)) == NULL)
+		die("msg=","naming hosts");
+	memcpy(name, buf, len + 1);
+	if ((slot = hash_set(names, name, len)) == NULL)
+		die("msg=","naming hosts");
+	*slot = name;
+	return name;
+}
+
+int
+main(int argc, char **argv)
+{
+	static char buf[1 << 16];
+	struct mem_pool pool = {0};
+	struct dhcp_state state = {0};
+	struct hash names = {0};
+	struct dhcp_lease **leases;
+	size_t n;
+	int c;
+
+	arg0 = *argv;
+	while ((c = getopt(argc, argv, "p:")) != -1) {
+		switch (c) {
+		case 'p':
+			prefix = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	state.pool = &pool;
+	if (array_init(&state.leases, sizeof(struct dhcp_lease *), &pool) < 0
+	 || hash_init(&state.macs, 0, &pool) < 0)
+		die("msg=","initializing data");
+
+	if (*argv == NULL)
+		dhcp_parse_file(&state, "/dev/stdin");
+	for (; *argv != NULL; argv++)
+		dhcp_parse_file(&state, (strcmp(*argv, "-") == 0) ? "/dev/stdin"
+		  : *argv);
+
+	leases = state.leases.mem;
+	n = array_length(&state.leases);
+	qsort(leases, n, sizeof *leases, dhcp_lease_cmp);
+	if (hash_init(&names, n, &pool) < 0)
+		die("msg=","naming hosts");
+
+	setvbuf(stdout, buf, _IOFBF, sizeof buf);
+	for (size_t i = 0; i < n; i++) {
+		char ip[IP_FMT_ADDR_LEN], mac[MAC_FMT_ADDR_LEN];
+
+		ip_fmt_addr(ip, leases[i]->ip);
+		mac_fmt_addr(mac, leases[i]->mac);
+		if (i > 0)
+			putchar('\n');
+		printf("[host]\nname = %s\nip = %s\nmac = %s\n",
+		  dhcp_name(&names, leases[i], &pool), ip, mac);
+	}
+
+	if (fflush(stdout) == EOF)
+		die("msg=","writing output");
+	mem_free(&pool);
+	return 0;
+}
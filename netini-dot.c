@@ -1,20 +1,144 @@
+#include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include <sys/wait.h>
+
+#include "compat.h"
 #include "conf.h"
+#include "hash.h"
 #include "ip.h"
+#include "layout.h"
 #include "log.h"
+#include "mac.h"
 #include "mem.h"
 #include "netini.h"
 
 static char const *style_node_net = "color=red shape=ellipse";
 static char const *style_node_host = "shape=rectangle";
+static char const *style_node_summary = "shape=box3d";
 static char const *style_edge_l1l2 = "color=grey,weight=2";
 static char const *style_edge_l2l3 = "color=red";
+static char const *style_edge_net = "color=red,style=bold";
+static char const *style_cluster_net = "style=dashed color=red";
+static char const *style_cluster_vlan = "style=rounded color=grey";
+static char const *indent = "\t\t\t\t";
 static char *arg0;
 
+/*
+ * Counters and timers enabled with -v or $NETINI_STATS, reported on stderr
+ * in logfmt. When off, only the counters increments remain.
+ */
+static struct {
+	int on;
+	struct mem_pool *pool;
+	size_t edges;
+} stats;
+
+struct phase {
+	char const *name;
+	struct timespec wall, cpu;
+	struct mem_stats mem;
+};
+
+static void
+phase_begin(struct phase *phase, char const *name)
+{
+	if (!stats.on)
+		return;
+	phase->name = name;
+	mem_pool_stats(stats.pool, &phase->mem);
+	clock_gettime(CLOCK_MONOTONIC, &phase->wall);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &phase->cpu);
+}
+
+static uintmax_t
+phase_usec(struct timespec *beg, struct timespec *end)
+{
+	return (end->tv_sec - beg->tv_sec) * 1000000
+	  + (end->tv_nsec - beg->tv_nsec) / 1000;
+}
+
+static void
+phase_end(struct phase *phase)
+{
+	struct timespec wall, cpu;
+	struct mem_stats mem;
+
+	if (!stats.on)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+	mem_pool_stats(stats.pool, &mem);
+	info("phase=",phase->name,
+	  "wall_us=",fmt(phase_usec(&phase->wall, &wall)),
+	  "cpu_us=",fmt(phase_usec(&phase->cpu, &cpu)),
+	  "mem_allocs=",fmt(mem.allocs - phase->mem.allocs),
+	  "mem_resizes=",fmt(mem.resizes - phase->mem.resizes),
+	  "mem_copied=",fmt(mem.copied - phase->mem.copied),
+	  "mem_bytes=",fmt(mem.bytes));
+}
+
+static void
+stats_report(struct netini_graph *graph)
+{
+	struct mem_stats mem;
+	size_t links = 0;
+
+	if (!stats.on)
+		return;
+
+	for (size_t i = 0; i < array_length(&graph->hosts); i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		links += array_length(&host->links);
+	}
+	mem_pool_stats(stats.pool, &mem);
+
+	info("files=",fmt(graph->nfiles), "bytes=",fmt(graph->nbytes),
+	  "sections=",fmt(graph->nsections),
+	  "variables=",fmt(graph->nvariables));
+	info("nets=",fmt(array_length(&graph->nets)),
+	  "hosts=",fmt(array_length(&graph->hosts)),
+	  "links=",fmt(links),
+	  "ipsecs=",fmt(array_length(&graph->ipsecs)));
+	info("probes=",fmt(graph->nprobes), "edges=",fmt(stats.edges));
+	info("mem_blocks=",fmt(mem.blocks), "mem_bytes=",fmt(mem.bytes),
+	  "mem_peak=",fmt(mem.peak), "mem_allocs=",fmt(mem.allocs),
+	  "mem_resizes=",fmt(mem.resizes), "mem_copied=",fmt(mem.copied));
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-cnv] [-a min] [-g pattern] [-l full|name|key,...] [-m max] "
+	  "[-s seed [-r radius]] [-T dot|svg|json|ndjson] [-i steps] [-j threads] "
+	  "[-o dir [-k max] [-x command]] [file...]\n", arg0);
+	exit(1);
+}
+
+/* number given to an option, nothing but digits and from min to max */
+static size_t
+parse_count(char const *arg, long long min, long long max)
+{
+	char const *errstr = NULL;
+	long long ll = 0;
+
+	if (isdigit((unsigned char)*arg))
+		ll = strtonum(arg, min, max, &errstr);
+	if (!isdigit((unsigned char)*arg) || errstr != NULL) {
+		errno = 0;
+		die("msg=","invalid number", "arg=",arg);
+	}
+	return ll;
+}
+
 void
 draw_beg(void)
 {
@@ -31,127 +155,1169 @@ void
 draw_edge(char const *left, char const *right, char const *style)
 {
 	fprintf(stdout, "\t\"%s\" -- \"%s\" [%s];\n", left, right, style);
+	stats.edges++;
 }
 
-void
-draw_node(char *s, struct conf_section *section, char const *style)
+/*
+ * What goes into the node labels, chosen with -l and -m, so that large
+ * graphs are not slowed down by details nobody reads.
+ */
+static struct {
+	enum { LABEL_FULL, LABEL_NAME, LABEL_KEYS } policy;
+	size_t max; /* values shown per key, 0 for all */
+	size_t node; /* incremented for each node drawn */
+	struct hash keys; /* char *key -> struct label_key */
+} label;
+
+struct label_key {
+	int shown;
+	size_t node; /* last node this key was counted for */
+	size_t count; /* number of values for that node */
+};
+
+static struct label_key *
+label_key(char const *key, struct mem_pool *pool)
+{
+	struct label_key **lk;
+
+	lk = (struct label_key **)hash_set(&label.keys, key, strlen(key));
+	if (lk == NULL)
+		return NULL;
+	if (*lk == NULL) {
+		*lk = mem_alloc(pool, sizeof **lk);
+		if (*lk == NULL)
+			return NULL;
+		/* in full mode, keys are added as they are met */
+		(*lk)->shown = (label.policy == LABEL_FULL);
+	}
+	return *lk;
+}
+
+static void
+label_init(char *arg, struct mem_pool *pool)
+{
+	struct label_key *lk;
+	char *key;
+
+	if (hash_init(&label.keys, 16, pool) < 0)
+		die("msg=","initializing label keys");
+
+	/* never part of the label: already shown as the node name or edges */
+	if ((lk = label_key("name", pool)) == NULL)
+		die("msg=","initializing label keys");
+	lk->shown = 0;
+	if ((lk = label_key("link", pool)) == NULL)
+		die("msg=","initializing label keys");
+	lk->shown = 0;
+
+	if (arg == NULL || strcmp(arg, "full") == 0)
+		return;
+	if (strcmp(arg, "name") == 0) {
+		label.policy = LABEL_NAME;
+		return;
+	}
+
+	label.policy = LABEL_KEYS;
+	for (key = strtok(arg, ","); key != NULL; key = strtok(NULL, ",")) {
+		for (char *s = key; *s != '\0'; s++)
+			*s = tolower((unsigned char)*s);
+		if ((lk = label_key(key, pool)) == NULL)
+			die("msg=","initializing label keys");
+		lk->shown = 1;
+	}
+}
+
+/*
+ * Call fn for each line of the label of the section, following the policy
+ * chosen, with more set to the number of values left out for the lines
+ * that summarize a truncated key.
+ */
+static void
+label_walk(struct conf_section *section, struct mem_pool *pool,
+	void (*fn)(char const *key, char const *value, size_t more))
 {
 	struct conf_variable *var;
-	size_t i;
+	struct label_key *lk;
+	size_t i, truncated = 0;
 
-	fprintf(stdout, "\t{ \"%s\" [%s,label=\"%s\\n", s, style, s);
+	if (label.policy == LABEL_NAME)
+		return;
 
+	label.node++;
 	i = 0;
 	while ((var = conf_next_variable(section, &i, NULL))) {
-		if (strcmp(var->key, "name") == 0)
+		if (label.policy == LABEL_KEYS)
+			lk = hash_get(&label.keys, var->key, strlen(var->key));
+		else if ((lk = label_key(var->key, pool)) == NULL)
+			die("msg=","adding label key");
+		if (lk == NULL || !lk->shown)
 			continue;
-		if (strcmp(var->key, "link") == 0)
+
+		if (lk->node != label.node) {
+			lk->node = label.node;
+			lk->count = 0;
+		}
+		if (label.max > 0 && ++lk->count > label.max) {
+			truncated = 1;
 			continue;
-		fprintf(stdout, "%s %s\\n", var->key, var->value);
+		}
+		fn(var->key, var->value, 0);
+	}
+
+	/* only walk the variables again for the nodes that had too many */
+	i = 0;
+	while (truncated && (var = conf_next_variable(section, &i, NULL))) {
+		lk = hash_get(&label.keys, var->key, strlen(var->key));
+		if (lk == NULL || lk->node != label.node || lk->count <= label.max)
+			continue;
+		fn(var->key, NULL, lk->count - label.max);
+		lk->count = 0;
 	}
-	fprintf(stdout, "\"] }\n");
+}
+
+static void
+draw_label_line(char const *key, char const *value, size_t more)
+{
+	if (more > 0)
+		fprintf(stdout, "%s (+%zu)\\n", key, more);
+	else
+		fprintf(stdout, "%s %s\\n", key, value);
 }
 
 void
-add_conf_to_graph(struct netini_graph *graph, char *path, struct mem_pool *pool)
+draw_node(char *s, struct conf_section *section, char const *style,
+	int depth, struct mem_pool *pool)
+{
+	if (label.policy == LABEL_NAME) {
+		fprintf(stdout, "%.*s{ \"%s\" [%s] }\n", depth, indent, s, style);
+		return;
+	}
+
+	fprintf(stdout, "%.*s{ \"%s\" [%s,label=\"%s\\n", depth, indent,
+	  s, style, s);
+	label_walk(section, pool, draw_label_line);
+	fprintf(stdout, "\"] }\n");
+}
+
+/*
+ * SVG output, from the positions computed by layout.c rather than
+ * Graphviz, with the label of each node as a tooltip.
+ */
+
+static void
+svg_escape(char const *s)
+{
+	for (; *s != '\0'; s++) {
+		switch (*s) {
+		case '&':
+			fputs("&amp;", stdout);
+			break;
+		case '<':
+			fputs("&lt;", stdout);
+			break;
+		case '>':
+			fputs("&gt;", stdout);
+			break;
+		case '"':
+			fputs("&quot;", stdout);
+			break;
+		default:
+			fputc(*s, stdout);
+		}
+	}
+}
+
+static void
+svg_label_line(char const *key, char const *value, size_t more)
+{
+	fputc('\n', stdout);
+	svg_escape(key);
+	if (more > 0) {
+		fprintf(stdout, " (+%zu)", more);
+	} else {
+		fputc(' ', stdout);
+		svg_escape(value);
+	}
+}
+
+static void
+svg_node(struct layout *layout, size_t node, char const *name,
+	struct conf_section *section, int is_net, struct mem_pool *pool)
+{
+	double w = strlen(name) * 6.5 + 10, h = 18;
+	double x = layout->x[node], y = layout->y[node];
+
+	fputs("<g><title>", stdout);
+	svg_escape(name);
+	label_walk(section, pool, svg_label_line);
+	fputs("</title>", stdout);
+	if (is_net)
+		fprintf(stdout, "<ellipse cx=\"%.1f\" cy=\"%.1f\" rx=\"%.1f\" "
+		  "ry=\"%.1f\" fill=\"white\" stroke=\"red\"/>",
+		  x, y, w / 2 + 4, h / 2 + 2);
+	else
+		fprintf(stdout, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" "
+		  "height=\"%.1f\" fill=\"white\" stroke=\"black\"/>",
+		  x - w / 2, y - h / 2, w, h);
+	fprintf(stdout, "<text x=\"%.1f\" y=\"%.1f\">", x, y + 4);
+	svg_escape(name);
+	fputs("</text></g>\n", stdout);
+}
+
+static void
+svg_graph(struct netini_graph *graph, uint8_t *reached, size_t steps,
+	int nthreads, struct mem_pool *pool)
+{
+	struct layout layout;
+	struct phase phase;
+	size_t nnets = array_length(&graph->nets);
+	double xmin = 0, ymin = 0, xmax = 0, ymax = 0;
+	int first = 1;
+
+	phase_begin(&phase, "layout");
+	if (layout_init(&layout, graph, reached, pool) < 0
+	 || layout_radial(&layout, graph) < 0
+	 || layout_force(&layout, graph, steps, nthreads) < 0)
+		die("msg=","computing the layout");
+	phase_end(&phase);
+
+	phase_begin(&phase, "svg");
+	for (size_t i = 0; i < layout.n; i++) {
+		if (reached != NULL && !reached[i])
+			continue;
+		if (first || layout.x[i] < xmin)
+			xmin = layout.x[i];
+		if (first || layout.x[i] > xmax)
+			xmax = layout.x[i];
+		if (first || layout.y[i] < ymin)
+			ymin = layout.y[i];
+		if (first || layout.y[i] > ymax)
+			ymax = layout.y[i];
+		first = 0;
+	}
+	xmin -= 200, ymin -= 40, xmax += 200, ymax += 40;
+
+	fprintf(stdout, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(stdout, "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+	  "viewBox=\"%.0f %.0f %.0f %.0f\" width=\"%.0f\" height=\"%.0f\" "
+	  "font-family=\"sans-serif\" font-size=\"11\" "
+	  "text-anchor=\"middle\">\n",
+	  xmin, ymin, xmax - xmin, ymax - ymin, xmax - xmin, ymax - ymin);
+
+	fprintf(stdout, "<g fill=\"none\">\n");
+	for (size_t i = 0; i < array_length(&graph->edges); i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+		size_t a = edge->node[0], b = edge->node[1];
+
+		if (a == NETINI_NONE || b == NETINI_NONE
+		 || (reached != NULL && (!reached[a] || !reached[b])))
+			continue;
+		fprintf(stdout, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" "
+		  "y2=\"%.1f\" stroke=\"%s\"/>\n",
+		  layout.x[a], layout.y[a], layout.x[b], layout.y[b],
+		  (edge->type == NETINI_E_L3 || edge->type == NETINI_E_NET)
+		  ? "red" : "grey");
+		stats.edges++;
+	}
+	fprintf(stdout, "</g>\n");
+
+	for (size_t i = 0; i < nnets; i++) {
+		struct netini_net *net = array_i(&graph->nets, i);
+
+		if (reached == NULL || reached[i])
+			svg_node(&layout, i, net->name, net->section, 1, pool);
+	}
+	for (size_t i = 0; i < array_length(&graph->hosts); i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		if (reached == NULL || reached[nnets + i])
+			svg_node(&layout, nnets + i, host->name, host->section,
+			  0, pool);
+	}
+
+	fprintf(stdout, "</svg>\n");
+	fflush(stdout);
+	phase_end(&phase);
+}
+
+/*
+ * JSON output, for other tools to read the graph without a dot parser:
+ * one object per node then per edge, on a line of its own with -T ndjson,
+ * or in the "nodes" and "edges" arrays of one document with -T json.
+ * The strings are copied as they are but for the JSON escapes, which
+ * keeps UTF-8 untouched.
+ */
+#define JSON_BUFSIZ (1 << 16)
+
+static void
+json_string(char const *s)
+{
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		unsigned char c = *s;
+
+		switch (c) {
+		case '"':
+			fputs("\\\"", stdout);
+			break;
+		case '\\':
+			fputs("\\\\", stdout);
+			break;
+		case '\n':
+			fputs("\\n", stdout);
+			break;
+		case '\r':
+			fputs("\\r", stdout);
+			break;
+		case '\t':
+			fputs("\\t", stdout);
+			break;
+		default:
+			if (c < 0x20)
+				printf("\\u%04x", c);
+			else
+				putchar(c);
+		}
+	}
+	putchar('"');
+}
+
+static void
+json_begin(char const *type, char const *kind, int ndjson, int *first)
+{
+	if (!ndjson && !*first)
+		fputs(",\n", stdout);
+	*first = 0;
+	fputs("{\"type\":", stdout);
+	json_string(type);
+	fputs(",\"kind\":", stdout);
+	json_string(kind);
+}
+
+static void
+json_end(int ndjson)
+{
+	fputs(ndjson ? "}\n" : "}", stdout);
+}
+
+/*
+ * All the variables of the section, the values of each key in an array,
+ * in the order of their first occurrence.
+ */
+static void
+json_vars(struct conf_section *section)
+{
+	size_t n = array_length(&section->variables);
+
+	fputs(",\"vars\":{", stdout);
+	for (size_t i = 0, first = 1; i < n; i++) {
+		struct conf_variable *var = array_i(&section->variables, i);
+		size_t j;
+
+		for (j = 0; j < i; j++) {
+			struct conf_variable *prev = array_i(&section->variables, j);
+
+			if (strcmp(prev->key, var->key) == 0)
+				break;
+		}
+		if (j < i)
+			continue;
+
+		if (!first)
+			putchar(',');
+		first = 0;
+		json_string(var->key);
+		fputs(":[", stdout);
+		for (j = i; j < n; j++) {
+			struct conf_variable *v = array_i(&section->variables, j);
+
+			if (strcmp(v->key, var->key) != 0)
+				continue;
+			if (j > i)
+				putchar(',');
+			json_string(v->value);
+		}
+		putchar(']');
+	}
+	putchar('}');
+}
+
+static void
+json_net(struct netini_net *net, int ndjson, int *first)
+{
+	char buf[IP_FMT_ADDR_LEN];
+
+	json_begin("node", "net", ndjson, first);
+	fputs(",\"name\":", stdout);
+	json_string(net->name);
+	ip_fmt_addr(buf, net->ip);
+	printf(",\"ip\":\"%s\",\"prefixlen\":%d", buf,
+	  ip_version(net->ip) == 4 ? net->mask - 96 : net->mask);
+	json_vars(net->section);
+	json_end(ndjson);
+}
+
+static void
+json_host(struct netini_host *host, int ndjson, int *first)
+{
+	char buf[IP_FMT_ADDR_LEN];
+
+	json_begin("node", "host", ndjson, first);
+	fputs(",\"name\":", stdout);
+	json_string(host->name);
+	fputs(",\"ips\":[", stdout);
+	for (size_t i = 0; i < array_length(&host->ips); i++) {
+		ip_fmt_addr(buf, array_i(&host->ips, i));
+		printf(i > 0 ? ",\"%s\"" : "\"%s\"", buf);
+	}
+	fputs("],\"macs\":[", stdout);
+	for (size_t i = 0; i < array_length(&host->macs); i++) {
+		mac_fmt_addr(buf, array_i(&host->macs, i));
+		printf(i > 0 ? ",\"%s\"" : "\"%s\"", buf);
+	}
+	putchar(']');
+	json_vars(host->section);
+	json_end(ndjson);
+}
+
+static void
+json_edge(struct netini_edge *edge, int ndjson, int *first)
+{
+	static char const *kinds[] = {
+		[NETINI_E_L3] = "l3", [NETINI_E_L2] = "l2", [NETINI_E_IPSEC] = "ipsec",
+		[NETINI_E_NET] = "net",
+	};
+
+	json_begin("edge", kinds[edge->type], ndjson, first);
+	fputs(",\"source\":", stdout);
+	json_string(edge->name[0]);
+	fputs(",\"target\":", stdout);
+	json_string(edge->name[1]);
+	json_end(ndjson);
+	stats.edges++;
+}
+
+static void
+json_graph(struct netini_graph *graph, uint8_t *reached, int ndjson)
+{
+	static char buf[JSON_BUFSIZ];
+	struct phase phase;
+	size_t nnets = array_length(&graph->nets);
+	int first = 1;
+
+	setvbuf(stdout, buf, _IOFBF, sizeof buf);
+
+	phase_begin(&phase, "nodes");
+	if (!ndjson)
+		fputs("{\"nodes\":[\n", stdout);
+	for (size_t i = 0; i < nnets; i++)
+		if (reached == NULL || reached[i])
+			json_net(array_i(&graph->nets, i), ndjson, &first);
+	for (size_t i = 0; i < array_length(&graph->hosts); i++)
+		if (reached == NULL || reached[nnets + i])
+			json_host(array_i(&graph->hosts, i), ndjson, &first);
+	phase_end(&phase);
+
+	phase_begin(&phase, "edges");
+	if (!ndjson)
+		fputs("\n],\"edges\":[\n", stdout);
+	first = 1;
+	for (size_t i = 0; i < array_length(&graph->edges); i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+
+		if (reached != NULL && (edge->node[0] == NETINI_NONE
+		 || edge->node[1] == NETINI_NONE
+		 || !reached[edge->node[0]] || !reached[edge->node[1]]))
+			continue;
+		json_edge(edge, ndjson, &first);
+	}
+	if (!ndjson)
+		fputs("\n]}\n", stdout);
+	fflush(stdout);
+	phase_end(&phase);
+}
+
+/* compute one kind of edges with fn, timed as the phase name */
+static void
+add_edges(struct netini_graph *graph, char const *name,
+	int (*fn)(struct netini_graph *))
 {
-	size_t ln = 0;
+	struct phase phase;
 	int err;
 
-	err = netini_add_conf(graph, path, &ln, pool);
+	phase_begin(&phase, name);
+	err = fn(graph);
 	if (err < 0)
-		die("msg=",netini_strerror(err), "path=",path, "line=",fmt(ln));
+		die("msg=",netini_strerror(err), "edges=",name);
+	phase_end(&phase);
 }
 
-int
-main(int argc, char **argv)
+/*
+ * Only keep the nodes up to radius edges away from the seeds, to render
+ * one part of the network without the cost of the whole.
+ */
+static uint8_t *
+reach_seeds(struct netini_graph *graph, struct array *seeds, size_t radius,
+	struct mem_pool *pool)
 {
-	struct mem_pool pool = {0};
-	struct netini_graph graph = {0};
-	size_t i1, i2, i3;
-	int err;
+	struct phase phase;
+	uint8_t *reached;
+	size_t *nodes, n = array_length(seeds);
 
-	arg0 = *argv++;
-	argc--;
+	phase_begin(&phase, "reach");
 
-	err = netini_init_graph(&graph, &pool);
-	if (err < 0)
-		die("msg=","initializing data");
+	reached = mem_alloc(pool, netini_node_count(graph) + 1);
+	nodes = mem_alloc(pool, n * sizeof *nodes);
+	if (reached == NULL || nodes == NULL)
+		die("msg=","allocating seeds");
+
+	for (size_t i = 0; i < n; i++) {
+		char *name = *(char **)array_i(seeds, i);
 
-	if (argc == 0) {
-		add_conf_to_graph(&graph, "/dev/stdin", &pool);
-	} else for (; *argv != NULL; argv++, argc--) {
-		char *path = (strcmp(*argv, "-") == 0) ? "/dev/stdin" : *argv;
-		add_conf_to_graph(&graph, path, &pool);
+		nodes[i] = netini_find_node(graph, name);
+		if (nodes[i] == NETINI_NONE)
+			die("msg=","no host or net with that name", "seed=",name);
 	}
+	if (netini_reach(graph, nodes, n, radius, reached) < 0)
+		die("msg=","searching the neighbourhood of the seeds");
+	mem_delete(nodes);
 
-	draw_beg();
+	phase_end(&phase);
+	return reached;
+}
 
-	/* graph nodes */
+/*
+ * With -a, the leaf hosts, with a single edge toward a net and no link= of
+ * their own, are collapsed into one summary node per net and per name
+ * prefix, such as "prefix-Vendor-" for "prefix-Vendor-N" named after the
+ * OUI of their MAC, to keep the infrastructure readable among thousands of
+ * workstations.
+ */
+struct summary {
+	char *id; /* "net/prefix-Vendor-*" */
+	char const *name; /* "prefix-Vendor-*", after the name of the net */
+	size_t net;
+	size_t first; /* node drawn in place of the whole group */
+	size_t count;
+};
 
-	for (i1 = 0; i1 < array_length(&graph.nets); i1++) {
-		struct netini_net *net = array_i(&graph.nets, i1);
+static struct {
+	size_t min; /* smallest group collapsed, 0 for none */
+	struct array summaries; /* struct summary */
+	size_t *group; /* summary of each node, or NETINI_NONE */
+} aggregate;
 
-		draw_node(net->name, net->section, style_node_net);
+/*
+ * Length of the name without the trailing number, or 0 if it does not end
+ * with "-N".
+ */
+static size_t
+aggregate_prefix(char const *name)
+{
+	size_t len = strlen(name), i = len;
+
+	while (i > 0 && isdigit((unsigned char)name[i - 1]))
+		i--;
+	if (i == len || i == 0 || name[i - 1] != '-')
+		return 0;
+	return i;
+}
+
+static void
+aggregate_graph(struct netini_graph *graph, uint8_t *reached,
+	struct mem_pool *pool)
+{
+	struct hash groups = {0};
+	struct phase phase;
+	size_t nnets = array_length(&graph->nets);
+	size_t n = netini_node_count(graph);
+	size_t *degree, *net, i;
+	char *key;
+
+	phase_begin(&phase, "aggregate");
+
+	degree = mem_alloc(pool, n * sizeof *degree + 1);
+	net = mem_alloc(pool, n * sizeof *net + 1);
+	aggregate.group = mem_alloc(pool, n * sizeof *aggregate.group + 1);
+	key = mem_alloc(pool, 64);
+	if (degree == NULL || net == NULL || aggregate.group == NULL || key == NULL
+	 || hash_init(&groups, 0, pool) < 0
+	 || array_init(&aggregate.summaries, sizeof(struct summary), pool) < 0)
+		die("msg=","allocating summaries");
+
+	for (i = 0; i < n; i++)
+		net[i] = aggregate.group[i] = NETINI_NONE;
+	for (i = 0; i < array_length(&graph->edges); i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+
+		if (edge->node[0] == NETINI_NONE || edge->node[1] == NETINI_NONE)
+			continue;
+		degree[edge->node[0]]++;
+		degree[edge->node[1]]++;
+		if (edge->type == NETINI_E_L3)
+			net[edge->node[1]] = edge->node[0];
 	}
 
-	for (i1 = 0; i1 < array_length(&graph.hosts); i1++) {
-		struct netini_host *host = array_i(&graph.hosts, i1);
+	for (i = nnets; i < n; i++) {
+		struct netini_host *host = array_i(&graph->hosts, i - nnets);
+		struct netini_net *hnet;
+		struct summary *summary, new = {0};
+		void **slot, *value;
+		size_t len, sz;
+
+		/* with a single edge, the net is only set if it is that edge */
+		if (degree[i] != 1 || net[i] == NETINI_NONE
+		 || array_length(&host->links) > 0
+		 || (reached != NULL && !reached[i])
+		 || (len = aggregate_prefix(host->name)) == 0)
+			continue;
+		hnet = array_i(&graph->nets, net[i]);
+
+		sz = strlen(hnet->name) + 1 + len + 2;
+		if (sz > mem_length(key) && mem_resize((void **)&key, sz) < 0)
+			die("msg=","allocating summaries");
+		snprintf(key, sz, "%s/%.*s*", hnet->name, (int)len, host->name);
 
-		draw_node(host->name, host->section, style_node_host);
+		/* values are the index of the summary + 1, as NULL is for new keys */
+		if ((value = hash_get(&groups, key, sz - 1)) == NULL) {
+			if ((new.id = mem_alloc(pool, sz)) == NULL)
+				die("msg=","allocating summaries");
+			memcpy(new.id, key, sz);
+			new.name = new.id + strlen(hnet->name) + 1;
+			new.net = net[i];
+			new.first = i;
+			if (array_append(&aggregate.summaries, &new) < 0
+			 || (slot = hash_set(&groups, new.id, sz - 1)) == NULL)
+				die("msg=","allocating summaries");
+			*slot = value = (void *)(uintptr_t)array_length(&aggregate.summaries);
+		}
+		aggregate.group[i] = (uintptr_t)value - 1;
+		summary = array_i(&aggregate.summaries, aggregate.group[i]);
+		summary->count++;
 	}
 
-	/* graph links: layer 3 topology */
+	/* too small groups stay as they are */
+	for (i = nnets; i < n; i++) {
+		struct summary *summary;
 
-	for (i1 = 0; i1 < array_length(&graph.nets); i1++) {
-		struct netini_net *net = array_i(&graph.nets, i1);
+		if (aggregate.group[i] == NETINI_NONE)
+			continue;
+		summary = array_i(&aggregate.summaries, aggregate.group[i]);
+		if (summary->count < aggregate.min)
+			aggregate.group[i] = NETINI_NONE;
+	}
 
-		for (i2 = 0; i2 < array_length(&graph.hosts); i2++) {
-			struct netini_host *host = array_i(&graph.hosts, i2);
+	mem_delete(key);
+	mem_delete(degree);
+	mem_delete(net);
+	phase_end(&phase);
+}
 
-			for (i3 = 0; i3 < array_length(&host->ips); i3++) {
-				uint8_t *ip = array_i(&host->ips, i3);
+static struct summary *
+aggregate_summary(size_t node)
+{
+	if (aggregate.min == 0 || aggregate.group[node] == NETINI_NONE)
+		return NULL;
+	return array_i(&aggregate.summaries, aggregate.group[node]);
+}
 
-				if (ip_match(ip, net->ip, net->mask))
-					draw_edge(net->name, host->name, style_edge_l2l3);
-			}
-		}
+/*
+ * Draw a host, or the summary node of its group in place of its first
+ * host and nothing for the others.
+ */
+static void
+draw_host(struct netini_graph *graph, size_t node, int depth,
+	struct mem_pool *pool)
+{
+	struct netini_host *host;
+	struct summary *summary;
+
+	if ((summary = aggregate_summary(node)) != NULL) {
+		if (summary->first == node)
+			fprintf(stdout, "%.*s{ \"%s\" [%s,label=\"%s (%zu)\"] }\n",
+			  depth, indent, summary->id, style_node_summary, summary->name,
+			  summary->count);
+		return;
+	}
+	host = array_i(&graph->hosts, node - array_length(&graph->nets));
+	draw_node(host->name, host->section, style_node_host, depth, pool);
+}
+
+/*
+ * With -c, each net becomes a cluster holding the hosts that have their
+ * first IP in it, and the nets sharing a vlan= value are clustered
+ * together, to let Graphviz lay out each part on its own.
+ */
+static int clusters;
+
+struct cluster {
+	char const *vlan; /* NULL for nets of no VLAN */
+	size_t net;
+};
+
+static int
+cluster_cmp(void const *a, void const *b)
+{
+	struct cluster const *ca = a, *cb = b;
+	int cmp;
+
+	if (ca->vlan == NULL || cb->vlan == NULL)
+		cmp = (ca->vlan == NULL) - (cb->vlan == NULL);
+	else
+		cmp = strcmp(ca->vlan, cb->vlan);
+	if (cmp == 0)
+		cmp = (ca->net > cb->net) - (ca->net < cb->net);
+	return cmp;
+}
+
+static int
+cluster_same_vlan(struct cluster *a, struct cluster *b)
+{
+	if (a->vlan == NULL || b->vlan == NULL)
+		return 0;
+	return strcmp(a->vlan, b->vlan) == 0;
+}
+
+static void
+draw_cluster_net(struct netini_graph *graph, size_t net, size_t *members,
+	size_t nmembers, int depth, struct mem_pool *pool)
+{
+	struct netini_net *n = array_i(&graph->nets, net);
+
+	fprintf(stdout, "%.*ssubgraph cluster_net_%zu {\n", depth, indent, net);
+	fprintf(stdout, "%.*sgraph [%s];\n", depth + 1, indent, style_cluster_net);
+	draw_node(n->name, n->section, style_node_net, depth + 1, pool);
+	for (size_t i = 0; i < nmembers; i++)
+		draw_host(graph, members[i], depth + 1, pool);
+	fprintf(stdout, "%.*s}\n", depth, indent);
+}
+
+static void
+draw_clusters(struct netini_graph *graph, uint8_t *reached,
+	struct mem_pool *pool)
+{
+	size_t nnets = array_length(&graph->nets);
+	size_t n = netini_node_count(graph);
+	size_t *primary, *first, *members, i, j;
+	struct cluster *sorted;
+
+	primary = mem_alloc(pool, n * sizeof *primary + 1);
+	first = mem_alloc(pool, (nnets + 2) * sizeof *first);
+	members = mem_alloc(pool, n * sizeof *members + 1);
+	sorted = mem_alloc(pool, nnets * sizeof *sorted + 1);
+	if (primary == NULL || first == NULL || members == NULL || sorted == NULL)
+		die("msg=","allocating clusters");
+
+	/* hosts grouped by net, with the hosts of no net in the last group */
+	netini_primary_nets(graph, reached, primary);
+	for (i = nnets; i < n; i++) {
+		if (primary[i] == NETINI_NONE)
+			primary[i] = nnets;
+		if (reached == NULL || reached[i])
+			first[primary[i] + 1]++;
 	}
+	for (i = 0; i <= nnets; i++)
+		first[i + 1] += first[i];
+	for (i = nnets; i < n; i++)
+		if (reached == NULL || reached[i])
+			members[first[primary[i]]++] = i;
+	for (i = nnets + 1; i > 0; i--)
+		first[i] = first[i - 1];
+	first[0] = 0;
 
-	/* graph links: layer 2 topology */
+	for (i = 0; i < nnets; i++) {
+		struct netini_net *net = array_i(&graph->nets, i);
+		size_t i2 = 0;
 
-	for (i1 = 0; i1 < array_length(&graph.hosts); i1++) {
-		struct netini_host *this = array_i(&graph.hosts, i1);
+		sorted[i].vlan = conf_next_value(net->section, &i2, "vlan");
+		sorted[i].net = i;
+	}
+	qsort(sorted, nnets, sizeof *sorted, cluster_cmp);
 
-		for (i2 = 0; i2 < array_length(&this->links); i2++) {
-			struct netini_link *link = array_i(&this->links, i2);
-			struct netini_host *other;
+	for (i = 0; i < nnets; i = j) {
+		int shown = 0, depth = 1;
 
-			i3 = 0;
-			while ((other = netini_next_linked(&graph.hosts, link, &i3)))
-				draw_edge(this->name, other->name, style_edge_l1l2);
+		for (j = i; j < nnets && (j == i || cluster_same_vlan(&sorted[i],
+		  &sorted[j])); j++)
+			shown |= (reached == NULL || reached[sorted[j].net]);
+		if (!shown)
+			continue;
+
+		if (sorted[i].vlan != NULL) {
+			fprintf(stdout, "\tsubgraph cluster_vlan_%zu {\n", sorted[i].net);
+			fprintf(stdout, "\t\tgraph [%s label=\"vlan %s\"];\n",
+			  style_cluster_vlan, sorted[i].vlan);
+			depth++;
+		}
+		for (size_t k = i; k < j; k++) {
+			size_t net = sorted[k].net;
+
+			if (reached == NULL || reached[net])
+				draw_cluster_net(graph, net, members + first[net],
+				  first[net + 1] - first[net], depth, pool);
 		}
+		if (sorted[i].vlan != NULL)
+			fprintf(stdout, "\t}\n");
 	}
 
-	/* graph links: IPsec VPNs */
+	for (i = first[nnets]; i < first[nnets + 1]; i++)
+		draw_host(graph, members[i], 1, pool);
 
-	for (i1 = 0; i1 < array_length(&graph.ipsecs); i1++) {
-		struct conf_section *section = array_i(&graph.ipsecs, i1);
-		char *h1;
+	mem_delete(primary);
+	mem_delete(first);
+	mem_delete(members);
+	mem_delete(sorted);
+}
 
-		i2 = 0;
-		while ((h1 = conf_next_value(section, &i2, "host"))) {
-			char *h2;
+static void
+draw_graph(struct netini_graph *graph, uint8_t *reached, struct mem_pool *pool)
+{
+	struct phase phase;
+	size_t nnets = array_length(&graph->nets);
+	size_t i;
 
-			i3 = i2;
-			while ((h2 = conf_next_value(section, &i3, "host")))
-				if (strcmp(h1, h2) != 0)
-					draw_edge(h1, h2, style_edge_l1l2);
+	draw_beg();
+
+	phase_begin(&phase, "nodes");
+	if (clusters) {
+		draw_clusters(graph, reached, pool);
+	} else {
+		for (i = 0; i < nnets; i++) {
+			struct netini_net *net = array_i(&graph->nets, i);
+
+			if (reached == NULL || reached[i])
+				draw_node(net->name, net->section, style_node_net, 1, pool);
 		}
+		for (i = nnets; i < netini_node_count(graph); i++)
+			if (reached == NULL || reached[i])
+				draw_host(graph, i, 1, pool);
 	}
+	phase_end(&phase);
+
+	phase_begin(&phase, "edges");
+	for (i = 0; i < array_length(&graph->edges); i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+		struct summary *summary;
+		char const *style, *right = edge->name[1];
+
+		if (reached != NULL && (edge->node[0] == NETINI_NONE
+		 || edge->node[1] == NETINI_NONE
+		 || !reached[edge->node[0]] || !reached[edge->node[1]]))
+			continue;
+		if (edge->type == NETINI_E_L3
+		 && (summary = aggregate_summary(edge->node[1])) != NULL) {
+			if (summary->first != edge->node[1])
+				continue;
+			right = summary->id;
+		}
+		style = (edge->type == NETINI_E_L3) ? style_edge_l2l3
+		  : (edge->type == NETINI_E_NET) ? style_edge_net : style_edge_l1l2;
+		draw_edge(edge->name[0], right, style);
+	}
+	phase_end(&phase);
 
 	draw_end();
+	fflush(stdout);
+}
+
+static void
+write_graph(struct netini_graph *graph, uint8_t *shown, char const *format,
+	size_t steps, int nthreads, struct mem_pool *pool)
+{
+	if (strcmp(format, "svg") == 0)
+		svg_graph(graph, shown, steps, nthreads, pool);
+	else if (strcmp(format, "json") == 0 || strcmp(format, "ndjson") == 0)
+		json_graph(graph, shown, strcmp(format, "ndjson") == 0);
+	else
+		draw_graph(graph, shown, pool);
+}
+
+/*
+ * With -o, the connected components are written each to its own file,
+ * largest first, so that mostly disjoint sites are laid out as many small
+ * jobs rather than a huge one. With -k, only the largest ones get their
+ * own file and all the others share one more. With -x, a command is run
+ * on each file, in up to -j processes at once.
+ */
+struct split {
+	char const *dir;
+	size_t max; /* files for the largest components, 0 for all */
+	char const *command;
+};
+
+/* for qsort(), which has no argument to pass it along */
+static size_t const *split_size;
+
+static int
+split_cmp(void const *a, void const *b)
+{
+	size_t ca = *(size_t const *)a, cb = *(size_t const *)b;
+
+	if (split_size[ca] != split_size[cb])
+		return (split_size[ca] < split_size[cb])
+		  - (split_size[ca] > split_size[cb]);
+	return (ca > cb) - (ca < cb);
+}
+
+static void
+split_run(struct array *paths, char const *command, int nthreads,
+	struct mem_pool *pool)
+{
+	struct phase phase;
+	size_t n = array_length(paths), running = 0, failed = 0;
+	pid_t *pids;
+	char *script;
+	size_t sz = strlen(command) + sizeof " \"$1\"";
+
+	phase_begin(&phase, "run");
+
+	pids = mem_alloc(pool, n * sizeof *pids + 1);
+	script = mem_alloc(pool, sz);
+	if (pids == NULL || script == NULL)
+		die("msg=","allocating processes");
+	snprintf(script, sz, "%s \"$1\"", command);
+	if (nthreads < 1)
+		nthreads = 1;
+
+	for (size_t i = 0; i < n || running > 0;) {
+		int status;
+		pid_t pid;
+
+		if (i < n && running < (size_t)nthreads) {
+			char *path = *(char **)array_i(paths, i);
+
+			if ((pids[i] = fork()) == -1)
+				die("msg=","starting the command");
+			if (pids[i] == 0) {
+				execl("/bin/sh", "sh", "-c", script, "sh", path, (char *)NULL);
+				_exit(127);
+			}
+			running++;
+			i++;
+			continue;
+		}
+
+		if ((pid = wait(&status)) == -1)
+			die("msg=","waiting for the command");
+		running--;
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			continue;
+		for (size_t i2 = 0; i2 < n; i2++)
+			if (pids[i2] == pid)
+				warn("msg=","command failed",
+				  "path=",*(char **)array_i(paths, i2));
+		failed++;
+	}
+
+	mem_delete(pids);
+	mem_delete(script);
+	phase_end(&phase);
+	if (failed > 0)
+		die("msg=","command failed for some components",
+		  "failed=",fmt(failed));
+}
+
+static void
+split_graph(struct netini_graph *graph, uint8_t *reached, struct split *split,
+	char const *format, size_t steps, int nthreads, struct mem_pool *pool)
+{
+	struct phase phase;
+	struct array paths = {0};
+	size_t n = netini_node_count(graph);
+	size_t *component, *size, *order, *rank, nfiles, i;
+	ssize_t ncomponents;
+	uint8_t *shown;
+
+	phase_begin(&phase, "components");
+	component = mem_alloc(pool, n * sizeof *component + 1);
+	shown = mem_alloc(pool, n + 1);
+	if (component == NULL || shown == NULL
+	 || array_init(&paths, sizeof(char *), pool) < 0)
+		die("msg=","allocating components");
+	if ((ncomponents = netini_components(graph, component)) < 0)
+		die("msg=","computing the components");
+
+	/* the size of a component is the number of its nodes shown */
+	size = mem_alloc(pool, ncomponents * sizeof *size + 1);
+	order = mem_alloc(pool, ncomponents * sizeof *order + 1);
+	rank = mem_alloc(pool, ncomponents * sizeof *rank + 1);
+	if (size == NULL || order == NULL || rank == NULL)
+		die("msg=","allocating components");
+	for (i = 0; i < n; i++)
+		if (reached == NULL || reached[i])
+			size[component[i]]++;
+	for (i = 0; i < (size_t)ncomponents; i++)
+		order[i] = i;
+	split_size = size;
+	qsort(order, ncomponents, sizeof *order, split_cmp);
+	for (i = 0; i < (size_t)ncomponents; i++)
+		rank[order[i]] = i;
+
+	/* components without any node shown are at the end */
+	for (nfiles = 0; nfiles < (size_t)ncomponents; nfiles++)
+		if (size[order[nfiles]] == 0)
+			break;
+	if (split->max > 0 && nfiles > split->max + 1)
+		nfiles = split->max + 1;
+	if (stats.on)
+		info("components=",fmt(ncomponents), "files=",fmt(nfiles));
+	phase_end(&phase);
+
+	for (size_t f = 0; f < nfiles; f++) {
+		char *path;
+		int last = (split->max > 0 && f == split->max);
+		size_t sz = strlen(split->dir) + strlen(format) + 64;
+
+		if ((path = mem_alloc(pool, sz)) == NULL)
+			die("msg=","allocating components");
+		if (last)
+			snprintf(path, sz, "%s/component-rest.%s", split->dir, format);
+		else
+			snprintf(path, sz, "%s/component-%zu.%s", split->dir, f + 1,
+			  format);
+		if (array_append(&paths, &path) < 0)
+			die("msg=","allocating components");
+
+		for (i = 0; i < n; i++)
+			shown[i] = (reached == NULL || reached[i])
+			  && (last ? rank[component[i]] >= f : rank[component[i]] == f);
+
+		if (freopen(path, "w", stdout) == NULL)
+			die("msg=","opening output", "path=",path);
+		write_graph(graph, shown, format, steps, nthreads, pool);
+		if (ferror(stdout))
+			die("msg=","writing output", "path=",path);
+	}
+	if (freopen("/dev/null", "w", stdout) == NULL)
+		die("msg=","closing output");
+
+	if (split->command != NULL)
+		split_run(&paths, split->command, nthreads, pool);
+
+	mem_delete(component);
+	mem_delete(shown);
+	mem_delete(order);
+	mem_delete(rank);
+	mem_delete(size);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct mem_pool pool = {0};
+	struct netini_graph graph = {0};
+	struct array seeds = {0};
+	struct split split = {0};
+	struct phase phase, total;
+	char *policy = NULL;
+	uint8_t *reached = NULL;
+	char *format = "dot", *pattern = "*.ini";
+	size_t radius = 1, steps = 100;
+	int c, err, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (array_init(&seeds, sizeof(char *), &pool) < 0)
+		die("msg=","initializing seeds");
+
+	arg0 = *argv;
+	while ((c = getopt(argc, argv, "a:cg:nvl:m:s:r:T:i:j:o:k:x:")) != -1) {
+		switch (c) {
+		case 'g':
+			pattern = optarg;
+			break;
+		case 'o':
+			split.dir = optarg;
+			break;
+		case 'k':
+			split.max = parse_count(optarg, 0, LLONG_MAX);
+			break;
+		case 'x':
+			split.command = optarg;
+			break;
+		case 'a':
+			aggregate.min = parse_count(optarg, 0, LLONG_MAX);
+			break;
+		case 'c':
+			clusters = 1;
+			break;
+		case 'n':
+			graph.nested = 1;
+			break;
+		case 'v':
+			stats.on = 1;
+			break;
+		case 'l':
+			policy = optarg;
+			break;
+		case 'm':
+			label.max = parse_count(optarg, 0, LLONG_MAX);
+			break;
+		case 's':
+			if (array_append(&seeds, &optarg) < 0)
+				die("msg=","adding seed");
+			break;
+		case 'r':
+			radius = parse_count(optarg, 0, LLONG_MAX);
+			break;
+		case 'T':
+			format = optarg;
+			if (strcmp(format, "dot") != 0 && strcmp(format, "svg") != 0
+			 && strcmp(format, "json") != 0
+			 && strcmp(format, "ndjson") != 0)
+				usage();
+			break;
+		case 'i':
+			steps = parse_count(optarg, 0, LLONG_MAX);
+			break;
+		case 'j':
+			nthreads = parse_count(optarg, 1, NETINI_THREADS_MAX);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	/* the summaries are only drawn by the dot output */
+	if (aggregate.min > 0 && strcmp(format, "dot") != 0)
+		usage();
+
+	if (getenv("NETINI_STATS") != NULL)
+		stats.on = 1;
+	stats.pool = &pool;
+
+	phase_begin(&total, "total");
+
+	err = netini_init_graph(&graph, &pool);
+	if (err < 0)
+		die("msg=","initializing data");
+	label_init(policy, &pool);
+
+	graph.nthreads = nthreads;
+
+	phase_begin(&phase, "load");
+	if ((err = netini_load(&graph, argv, pattern, nthreads, &pool)) < 0)
+		die("msg=",netini_strerror(err), "path=",graph.failed.path,
+		  "line=",fmt(graph.failed.ln));
+	phase_end(&phase);
+
+	add_edges(&graph, "l3", netini_add_l3_edges);
+	add_edges(&graph, "l2", netini_add_l2_edges);
+	add_edges(&graph, "ipsec", netini_add_ipsec_edges);
+
+	if (array_length(&seeds) > 0)
+		reached = reach_seeds(&graph, &seeds, radius, &pool);
+
+	if (aggregate.min > 0)
+		aggregate_graph(&graph, reached, &pool);
+
+	if (split.dir != NULL)
+		split_graph(&graph, reached, &split, format, steps, nthreads, &pool);
+	else
+		write_graph(&graph, reached, format, steps, nthreads, &pool);
+	phase_end(&total);
 
+	stats_report(&graph);
 	mem_free(&pool);
 	return 0;
 }
@@ -0,0 +1,481 @@
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "compat.h"
+#include "hash.h"
+#include "load.h"
+#include "log.h"
+#include "mac.h"
+#include "mem.h"
+
+/*
+ * Import the forwarding tables of switches as the link= entries of one
+ * [host] per switch, from the MACs they learned on each port.
+ *
+ * A port with few MACs is an access port, and the switch gets a link to
+ * each of them. A port with more, or where the own MAC of another switch
+ * is seen, is an uplink: it leads to the other switches and the hosts
+ * behind them. In a tree, of all the switches seen through an uplink, the
+ * one directly at the other end is the one whose own port facing back
+ * sees the fewest MACs, as the ones further away also see the MACs of the
+ * switches in between.
+ *
+ * The distinct pairs of port and MAC are counted in a hash table, as every
+ * VLAN repeats them, and sorted once, so that millions of rows go through.
+ */
+
+#define FDB_TOKENS_MAX 16
+#define FDB_KEY_LEN (4 + 6)
+#define FDB_CHUNK 65536
+
+static char *arg0;
+
+struct fdb_switch {
+	char const *name;
+	struct array macs; /* uint8_t[6] of the switch itself */
+};
+
+struct fdb_port {
+	size_t sw;
+	char *name;
+	size_t nmacs;
+};
+
+struct fdb_state {
+	struct array switches; /* struct fdb_switch */
+	struct array ports; /* struct fdb_port */
+	struct array keys; /* uint8_t[FDB_KEY_LEN]: uint32_t port, MAC */
+	struct hash port_names; /* "switch/port" -> port index + 1 */
+	struct hash pairs; /* uint8_t[FDB_KEY_LEN] -> (void *)1 */
+	struct hash owners; /* uint8_t mac[6] -> switch index + 1 */
+	struct hash facing; /* size_t[2] switches -> port index + 1 */
+	struct hash links; /* size_t[2] switches -> (void *)1 */
+	size_t last; /* port of the previous row, often the same */
+	uint8_t *chunk; /* storage of the keys of the hash tables */
+	size_t nfree;
+	struct mem_pool *pool;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-u max] [-n name] (freebsd|linux|mikrotik)"
+	  " [file...]\n", arg0);
+	exit(1);
+}
+
+/* stable copy of a key, which the hash tables do not copy */
+static void *
+fdb_keep(struct fdb_state *state, void const *key, size_t len)
+{
+	void *p;
+
+	if (state->nfree < len) {
+		if ((state->chunk = mem_alloc(state->pool, FDB_CHUNK)) == NULL)
+			die("msg=","storing keys");
+		state->nfree = FDB_CHUNK;
+	}
+	p = state->chunk + FDB_CHUNK - state->nfree;
+	state->nfree -= len;
+	memcpy(p, key, len);
+	return p;
+}
+
+static size_t
+fdb_port(struct fdb_state *state, size_t sw, char const *name)
+{
+	struct fdb_port port = {0};
+	struct fdb_port *last;
+	char key[512];
+	size_t len;
+	void **slot;
+
+	if (state->last < array_length(&state->ports)) {
+		last = array_i(&state->ports, state->last);
+		if (last->sw == sw && strcmp(last->name, name) == 0)
+			return state->last;
+	}
+
+	len = snprintf(key, sizeof key, "%zu/%s", sw, name);
+	if (len >= sizeof key)
+		len = sizeof key - 1;
+	if ((slot = hash_get(&state->port_names, key, len)) != NULL)
+		return state->last = (uintptr_t)slot - 1;
+
+	port.sw = sw;
+	port.name = fdb_keep(state, name, strlen(name) + 1);
+	if (array_append(&state->ports, &port) < 0)
+		die("msg=","adding a port");
+	slot = hash_set(&state->port_names, fdb_keep(state, key, len), len);
+	if (slot == NULL)
+		die("msg=","adding a port");
+	*slot = (void *)(uintptr_t)array_length(&state->ports);
+	return state->last = array_length(&state->ports) - 1;
+}
+
+static void
+fdb_add(struct fdb_state *state, size_t sw, char const *port, uint8_t *mac)
+{
+	uint8_t key[FDB_KEY_LEN];
+	uint32_t u32;
+	void **slot;
+	size_t i;
+
+	/* broadcast and multicast */
+	if (mac[0] & 1)
+		return;
+
+	i = fdb_port(state, sw, port);
+	u32 = i;
+	memcpy(key, &u32, 4);
+	memcpy(key + 4, mac, 6);
+	if (hash_get(&state->pairs, key, sizeof key) != NULL)
+		return;
+	if ((slot = hash_set(&state->pairs, fdb_keep(state, key, sizeof key),
+	  sizeof key)) == NULL || array_append(&state->keys, key) < 0)
+		die("msg=","adding a mac");
+	*slot = (void *)1;
+	((struct fdb_port *)array_i(&state->ports, i))->nmacs++;
+}
+
+static void
+fdb_own(struct fdb_state *state, size_t sw, uint8_t *mac)
+{
+	struct fdb_switch *s = array_i(&state->switches, sw);
+	void **slot;
+
+	if (mac[0] & 1)
+		return;
+	if (hash_get(&state->owners, mac, 6) != NULL)
+		return;
+	if ((slot = hash_set(&state->owners, fdb_keep(state, mac, 6), 6)) == NULL
+	 || array_append(&s->macs, mac) < 0)
+		die("msg=","adding a mac");
+	*slot = (void *)(uintptr_t)(sw + 1);
+}
+
+static int
+fdb_mac(char const *s, uint8_t *mac)
+{
+	char const *end = mac_parse_addr(s, mac);
+
+	return end != NULL && *end == '\0';
+}
+
+/* bridge fdb show: MAC dev PORT [vlan N] [master BRIDGE] [flags...] */
+static void
+fdb_linux(struct fdb_state *state, size_t sw, char **tok, size_t ntok)
+{
+	uint8_t mac[6];
+
+	if (ntok < 3 || !fdb_mac(tok[0], mac) || strcmp(tok[1], "dev") != 0)
+		return;
+	for (size_t i = 3; i < ntok; i++) {
+		if (strcmp(tok[i], "permanent") == 0) {
+			fdb_own(state, sw, mac);
+			return;
+		}
+	}
+	fdb_add(state, sw, tok[2], mac);
+}
+
+/* ifconfig bridge0 addr: MAC VlanN PORT EXPIRE FLAGS */
+static void
+fdb_freebsd(struct fdb_state *state, size_t sw, char **tok, size_t ntok)
+{
+	uint8_t mac[6];
+
+	if (ntok < 3 || !fdb_mac(tok[0], mac))
+		return;
+	fdb_add(state, sw, tok[2], mac);
+}
+
+/* /interface bridge host print: # FLAGS MAC [VLAN] PORT BRIDGE */
+static void
+fdb_mikrotik(struct fdb_state *state, size_t sw, char **tok, size_t ntok)
+{
+	uint8_t mac[6];
+	size_t i;
+	int local = 0;
+
+	for (i = 0; i < ntok && !fdb_mac(tok[i], mac); i++)
+		if (i > 0 && strchr(tok[i], 'L') != NULL)
+			local = 1;
+	if (i == ntok)
+		return;
+	if (local) {
+		fdb_own(state, sw, mac);
+		return;
+	}
+	if (++i < ntok && isdigit((unsigned char)tok[i][0]))
+		i++;
+	if (i < ntok)
+		fdb_add(state, sw, tok[i], mac);
+}
+
+static void
+fdb_parse_file(struct fdb_state *state, char const *path, char const *name,
+	void (*fn)(struct fdb_state *, size_t, char **, size_t))
+{
+	struct fdb_switch sw = {0};
+	char *line = NULL;
+	size_t sz = 0, i;
+	FILE *fp;
+
+	sw.name = name;
+	if (array_init(&sw.macs, 6, state->pool) < 0
+	 || array_append(&state->switches, &sw) < 0)
+		die("msg=","adding a switch");
+	i = array_length(&state->switches) - 1;
+
+	fp = (strcmp(path, "/dev/stdin") == 0) ? stdin : fopen(path, "r");
+	if (fp == NULL)
+		die("msg=","opening input", "path=",path);
+	while (getline(&line, &sz, fp) > 0) {
+		char *tok[FDB_TOKENS_MAX];
+		size_t ntok;
+
+		ntok = load_split(line, " \t\r\n", tok, FDB_TOKENS_MAX);
+		fn(state, i, tok, ntok);
+	}
+	if (ferror(fp))
+		die("msg=","reading input", "path=",path);
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+}
+
+static uint32_t
+fdb_key_port(uint8_t const *key)
+{
+	uint32_t u32;
+
+	memcpy(&u32, key, 4);
+	return u32;
+}
+
+static int
+fdb_key_cmp(void const *v1, void const *v2)
+{
+	uint32_t p1 = fdb_key_port(v1), p2 = fdb_key_port(v2);
+
+	if (p1 != p2)
+		return (p1 > p2) - (p1 < p2);
+	return memcmp((uint8_t const *)v1 + 4, (uint8_t const *)v2 + 4, 6);
+}
+
+/* switch owning the MAC of key, or (size_t)-1 */
+static size_t
+fdb_owner(struct fdb_state *state, uint8_t const *key)
+{
+	uintptr_t u = (uintptr_t)hash_get(&state->owners, key + 4, 6);
+
+	return u - 1;
+}
+
+/*
+ * Index the port of each switch facing each other switch: the one where
+ * it sees an own MAC of the other.
+ */
+static void
+fdb_index_facing(struct fdb_state *state, uint8_t *keys, size_t nkeys)
+{
+	for (size_t i = 0; i < nkeys; i++) {
+		uint32_t p = fdb_key_port(keys + i * FDB_KEY_LEN);
+		struct fdb_port *port = array_i(&state->ports, p);
+		size_t pair[2];
+		void **slot;
+
+		if ((pair[1] = fdb_owner(state, keys + i * FDB_KEY_LEN)) == (size_t)-1)
+			continue;
+		pair[0] = port->sw;
+		if (hash_get(&state->facing, pair, sizeof pair) != NULL)
+			continue;
+		slot = hash_set(&state->facing, fdb_keep(state, pair, sizeof pair),
+		  sizeof pair);
+		if (slot == NULL)
+			die("msg=","indexing ports");
+		*slot = (void *)(uintptr_t)(p + 1);
+	}
+}
+
+/* port of switch sw facing switch other, or (size_t)-1 */
+static size_t
+fdb_facing(struct fdb_state *state, size_t sw, size_t other)
+{
+	size_t pair[2] = { sw, other };
+
+	return (uintptr_t)hash_get(&state->facing, pair, sizeof pair) - 1;
+}
+
+/*
+ * Switch directly at the other end of the uplink of the keys from beg to
+ * end, all on the same port, or (size_t)-1.
+ */
+static size_t
+fdb_neighbour(struct fdb_state *state, uint8_t *keys, size_t beg, size_t end)
+{
+	struct fdb_port *port;
+	size_t best = (size_t)-1, fewest = (size_t)-1;
+
+	port = array_i(&state->ports, fdb_key_port(keys + beg * FDB_KEY_LEN));
+	for (size_t i = beg; i < end; i++) {
+		size_t other = fdb_owner(state, keys + i * FDB_KEY_LEN), facing;
+		size_t n;
+
+		if (other == (size_t)-1 || other == port->sw)
+			continue;
+		facing = fdb_facing(state, other, port->sw);
+		n = (facing == (size_t)-1) ? (size_t)-2
+		  : ((struct fdb_port *)array_i(&state->ports, facing))->nmacs;
+		if (n < fewest || best == (size_t)-1)
+			best = other, fewest = n;
+	}
+	return best;
+}
+
+static void
+fdb_write(struct fdb_state *state, size_t max)
+{
+	uint8_t *keys = state->keys.mem;
+	size_t nkeys = array_length(&state->keys), i = 0;
+
+	qsort(keys, nkeys, FDB_KEY_LEN, fdb_key_cmp);
+	fdb_index_facing(state, keys, nkeys);
+
+	/* ports in the order of the switches, as they were added */
+	for (size_t sw = 0; sw < array_length(&state->switches); sw++) {
+		struct fdb_switch *s = array_i(&state->switches, sw);
+		char buf[MAC_FMT_ADDR_LEN];
+
+		if (sw > 0)
+			putchar('\n');
+		printf("[host]\nname = %s\n", s->name);
+		for (size_t m = 0; m < array_length(&s->macs); m++) {
+			mac_fmt_addr(buf, array_i(&s->macs, m));
+			printf("mac = %s\n", buf);
+		}
+
+		while (i < nkeys) {
+			uint32_t p = fdb_key_port(keys + i * FDB_KEY_LEN);
+			struct fdb_port *port = array_i(&state->ports, p);
+			size_t end = i, other;
+
+			if (port->sw != sw)
+				break;
+			while (end < nkeys && fdb_key_port(keys + end * FDB_KEY_LEN) == p)
+				end++;
+
+			other = fdb_neighbour(state, keys, i, end);
+			if (other != (size_t)-1 || port->nmacs > max) {
+				printf("uplink = %s\n", port->name);
+				if (other != (size_t)-1) {
+					size_t pair[2];
+					void **slot;
+
+					pair[0] = (sw < other) ? sw : other;
+					pair[1] = (sw < other) ? other : sw;
+					if (hash_get(&state->links, pair, sizeof pair) == NULL) {
+						slot = hash_set(&state->links,
+						  fdb_keep(state, pair, sizeof pair), sizeof pair);
+						if (slot == NULL)
+							die("msg=","linking switches");
+						*slot = (void *)1;
+						printf("link = %s\n", ((struct fdb_switch *)
+						  array_i(&state->switches, other))->name);
+					}
+				}
+			} else {
+				for (; i < end; i++) {
+					mac_fmt_addr(buf, keys + i * FDB_KEY_LEN + 4);
+					printf("link = %s\n", buf);
+				}
+			}
+			i = end;
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	static char buf[1 << 16];
+	struct mem_pool pool = {0};
+	struct fdb_state state = {0};
+	void (*fn)(struct fdb_state *, size_t, char **, size_t);
+	char const *name = NULL, *errstr;
+	size_t max = 4;
+	int c;
+
+	arg0 = *argv;
+	while ((c = getopt(argc, argv, "n:u:")) != -1) {
+		switch (c) {
+		case 'n':
+			name = optarg;
+			break;
+		case 'u':
+			max = strtonum(optarg, 1, INT_MAX, &errstr);
+			if (errstr != NULL)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (*argv == NULL)
+		usage();
+	if (strcmp(*argv, "linux") == 0)
+		fn = fdb_linux;
+	else if (strcmp(*argv, "freebsd") == 0)
+		fn = fdb_freebsd;
+	else if (strcmp(*argv, "mikrotik") == 0)
+		fn = fdb_mikrotik;
+	else
+		usage();
+	argv++;
+
+	state.pool = &pool;
+	if (array_init(&state.switches, sizeof(struct fdb_switch), &pool) < 0
+	 || array_init(&state.ports, sizeof(struct fdb_port), &pool) < 0
+	 || array_init(&state.keys, FDB_KEY_LEN, &pool) < 0
+	 || hash_init(&state.port_names, 0, &pool) < 0
+	 || hash_init(&state.pairs, 0, &pool) < 0
+	 || hash_init(&state.owners, 0, &pool) < 0
+	 || hash_init(&state.facing, 0, &pool) < 0
+	 || hash_init(&state.links, 0, &pool) < 0)
+		die("msg=","initializing data");
+
+	if (*argv == NULL) {
+		if (name == NULL)
+			die("msg=","-n is needed to read the standard input");
+		fdb_parse_file(&state, "/dev/stdin", name, fn);
+	}
+	for (; *argv != NULL; argv++) {
+		char const *sw;
+
+		if (strcmp(*argv, "-") == 0 && name == NULL)
+			die("msg=","-n is needed to read the standard input");
+		if (strcmp(*argv, "-") == 0)
+			fdb_parse_file(&state, "/dev/stdin", name, fn);
+		else if ((sw = load_name(*argv, &pool)) == NULL)
+			die("msg=","naming switches");
+		else
+			fdb_parse_file(&state, *argv, sw, fn);
+	}
+
+	setvbuf(stdout, buf, _IOFBF, sizeof buf);
+	fdb_write(&state, max);
+	if (fflush(stdout) == EOF)
+		die("msg=","writing output");
+	mem_free(&pool);
+	return 0;
+}
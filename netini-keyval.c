@@ -1,40 +1,259 @@
-#include <dirent.h>
 #include <errno.h>
+#include <fnmatch.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
 
+#include "array.h"
+#include "compat.h"
 #include "conf.h"
-#include "ip.h"
+#include "load.h"
 #include "log.h"
 #include "mem.h"
 
-int
-main(int argc, char **argv)
+/*
+ * Extract values of the inventory as "name key value" rows, of the
+ * sections selected by selectors such as:
+ *
+ *	host.ip			every ip of every host
+ *	net[vlan=20].name	name of the nets of VLAN 20
+ *	*[name=sw*].*		every variable of what has a name starting with sw
+ *
+ * The files are read ahead by the threads of load_files(), and each is
+ * parsed, printed and freed before the next, so that the memory used is
+ * the one of the largest file rather than of the whole inventory.
+ */
+
+#define KEYVAL_FILTERS_MAX 8
+
+static char *arg0;
+
+struct keyval_filter {
+	char const *key;
+	char const *pattern; /* NULL for the key to be present */
+};
+
+struct keyval_selector {
+	char const *section; /* "*" for any */
+	struct keyval_filter filters[KEYVAL_FILTERS_MAX];
+	size_t nfilters;
+	char const *key; /* "*" for any */
+};
+
+struct keyval {
+	struct keyval_selector *selectors;
+	size_t nselectors;
+	size_t nrows, max; /* 0 for no maximum */
+	int nthreads;
+	size_t ln;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-g pattern] [-j threads] [-m max]"
+	  " [-e selector]... [selector] [file...]\n", arg0);
+	exit(1);
+}
+
+/* section[key=pattern]...key, cut in a copy of arg */
+static void
+keyval_parse(struct keyval_selector *sel, char const *arg,
+	struct mem_pool *pool)
 {
+	size_t len = strlen(arg);
+	char *s;
+
+	if ((s = mem_alloc(pool, len + 1)) == NULL)
+		die("msg=","parsing selectors");
+	memcpy(s, arg, len + 1);
+	memset(sel, 0, sizeof *sel);
+	sel->section = s;
+	s += strcspn(s, "[.");
+	while (*s == '[') {
+		struct keyval_filter *filter;
+		char *eq;
+
+		if (sel->nfilters == KEYVAL_FILTERS_MAX)
+			die("msg=","too many filters in selector", "selector=",arg);
+		filter = &sel->filters[sel->nfilters++];
+		*s++ = '\0';
+		filter->key = s;
+		if ((s = strchr(s, ']')) == NULL)
+			die("msg=","expecting closing bracket", "selector=",arg);
+		*s++ = '\0';
+		if ((eq = strchr(filter->key, '=')) != NULL) {
+			*eq = '\0';
+			filter->pattern = eq + 1;
+		}
+		if (*filter->key == '\0')
+			die("msg=","empty key in filter", "selector=",arg);
+	}
+	if (*s != '.' || s[1] == '\0' || strchr(s + 1, '.') != NULL)
+		die("msg=","expecting section.key", "selector=",arg);
+	*s++ = '\0';
+	sel->key = s;
+	if (*sel->section == '\0')
+		sel->section = "*";
+}
+
+static int
+keyval_filter(struct conf_section *section, struct keyval_filter *filter)
+{
+	struct conf_variable *var;
+	size_t i = 0;
+
+	while ((var = conf_next_variable(section, &i, filter->key)) != NULL)
+		if (filter->pattern == NULL
+		 || fnmatch(filter->pattern, var->value, 0) == 0)
+			return 1;
+	return 0;
+}
+
+/* print the rows of the section, and tell whether the maximum is reached */
+static int
+keyval_section(struct keyval *kv, struct keyval_selector *sel,
+	struct conf_section *section)
+{
+	struct conf_variable *var;
+	char const *name, *key;
+	size_t i;
+
+	if (strcmp(sel->section, "*") != 0
+	 && strcasecmp(sel->section, section->name) != 0)
+		return 0;
+	for (size_t f = 0; f < sel->nfilters; f++)
+		if (!keyval_filter(section, &sel->filters[f]))
+			return 0;
+
+	i = 0;
+	if ((name = conf_next_value(section, &i, "name")) == NULL)
+		name = "-";
+	key = (strcmp(sel->key, "*") == 0) ? NULL : sel->key;
+	for (i = 0; (var = conf_next_variable(section, &i, key)) != NULL;) {
+		fputs(name, stdout);
+		putchar(' ');
+		fputs(var->key, stdout);
+		putchar(' ');
+		fputs(var->value, stdout);
+		putchar('\n');
+		if (++kv->nrows == kv->max)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Called by load_files() on each file in order, which is stopped with -1
+ * and errno at 0 once the maximum of rows is printed.
+ */
+static int
+keyval_file(void *arg, char const *path, char *buf, size_t len)
+{
+	struct keyval *kv = arg;
 	struct mem_pool pool = {0};
-	size_t i1, i2, i3;
+	struct conf conf = {0};
+	struct conf_section *section;
 	int err;
 
-	arg0 = *argv++;
-	argc--;
+	kv->ln = 0;
+	if (buf == NULL)
+		err = conf_parse_file_parallel(&conf, path, kv->nthreads, &kv->ln,
+		  &pool);
+	else
+		err = conf_parse_buffer(&conf, buf, len, path, &kv->ln, &pool);
 
-	for (i1 = 0; i1 < array_length(&graph.ipsecs); i1++) {
-		struct conf_section *section = array_i(&graph.ipsecs, i1);
-		char *h1;
+	for (size_t i = 0; err == 0
+	 && (section = conf_next_section(&conf, &i, NULL)) != NULL;) {
+		for (size_t s = 0; s < kv->nselectors; s++) {
+			if (keyval_section(kv, &kv->selectors[s], section)) {
+				errno = 0;
+				err = -1;
+				break;
+			}
+		}
+	}
+	mem_free(&pool);
+	return err;
+}
 
-		i2 = 0;
-		while ((h1 = conf_next_value(section, &i2, "host"))) {
-			char *h2;
+int
+main(int argc, char **argv)
+{
+	static char buf[1 << 16];
+	struct mem_pool pool = {0};
+	struct keyval kv = {0};
+	struct array paths = {0};
+	char **exprs, *pattern = "*.ini";
+	char const *errstr;
+	size_t nexprs = 0, failed = 0;
+	int c, err;
 
-			i3 = i2;
-			while ((h2 = conf_next_value(section, &i3, "host")))
-				if (strcmp(h1, h2) != 0)
-					draw_edge(h1, h2, style_edge_l1l2);
+	arg0 = *argv;
+	kv.nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if ((exprs = mem_alloc(&pool, (argc + 1) * sizeof *exprs)) == NULL)
+		die("msg=","parsing arguments");
+	while ((c = getopt(argc, argv, "e:g:j:m:")) != -1) {
+		switch (c) {
+		case 'e':
+			exprs[nexprs++] = optarg;
+			break;
+		case 'g':
+			pattern = optarg;
+			break;
+		case 'j':
+			kv.nthreads = strtonum(optarg, 1, LOAD_THREADS_MAX, &errstr);
+			if (errstr != NULL)
+				usage();
+			break;
+		case 'm':
+			kv.max = strtonum(optarg, 0, LLONG_MAX, &errstr);
+			if (errstr != NULL)
+				usage();
+			break;
+		default:
+			usage();
 		}
 	}
+	argc -= optind;
+	argv += optind;
+
+	if (nexprs == 0) {
+		if (*argv == NULL)
+			usage();
+		exprs[nexprs++] = *argv++;
+	}
+	if ((kv.selectors = mem_alloc(&pool, nexprs * sizeof *kv.selectors)) == NULL)
+		die("msg=","parsing selectors");
+	for (; kv.nselectors < nexprs; kv.nselectors++)
+		keyval_parse(&kv.selectors[kv.nselectors], exprs[kv.nselectors],
+		  &pool);
+
+	if (array_init(&paths, sizeof(char *), &pool) < 0)
+		die("msg=","initializing paths");
+	if (*argv == NULL && load_expand("/dev/stdin", pattern, kv.nthreads,
+	  &paths, &pool) < 0)
+		die("msg=","adding input", "path=","/dev/stdin");
+	for (; *argv != NULL; argv++) {
+		char *path = (strcmp(*argv, "-") == 0) ? "/dev/stdin" : *argv;
+
+		if (load_expand(path, pattern, kv.nthreads, &paths, &pool) < 0)
+			die("msg=","listing input files", "path=",path);
+	}
 
-	draw_end();
+	setvbuf(stdout, buf, _IOFBF, sizeof buf);
+	err = load_files(&paths, kv.nthreads, keyval_file, &kv, &failed);
+	if (err == -1 && (kv.max == 0 || kv.nrows < kv.max))
+		die("msg=","reading input", "path=",*(char **)array_i(&paths, failed));
+	if (err < -1)
+		die("msg=",conf_strerror(err),
+		  "path=",*(char **)array_i(&paths, failed), "line=",fmt(kv.ln));
 
+	if (fflush(stdout) == EOF)
+		die("msg=","writing output");
 	mem_free(&pool);
 	return 0;
 }
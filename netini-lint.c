@@ -0,0 +1,406 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compat.h"
+#include "conf.h"
+#include "hash.h"
+#include "ip.h"
+#include "log.h"
+#include "mac.h"
+#include "mem.h"
+#include "netini.h"
+
+/*
+ * Every check sorts or hashes the addresses and names once, rather than
+ * comparing every item with every other, to stay fast on large
+ * inventories: O(n log n) for n addresses.
+ */
+
+static char *arg0;
+static int supernets;
+static size_t nproblems;
+
+struct lint_ip {
+	uint8_t ip[16];
+	size_t host;
+};
+
+struct lint_mac {
+	uint8_t mac[6];
+	size_t host;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-s] [-g pattern] [-j threads] [file...]\n",
+	  arg0);
+	exit(1);
+}
+
+/* count and log a problem as "key=",value pairs ended by NULL, like warn() */
+static void
+problem(char const *fmt, ...)
+{
+	va_list va;
+
+	nproblems++;
+	va_start(va, fmt);
+	fputs("error ", stderr);
+	log_vprintf(fmt, va);
+	fputc('\n', stderr);
+	va_end(va);
+}
+
+/*
+ * Path of the file the net or host comes from, found by a binary search
+ * of the last file starting at or before it.
+ */
+static char const *
+lint_path(struct array *files, size_t i, int is_host)
+{
+	size_t beg = 0, end = array_length(files);
+
+	while (end - beg > 1) {
+		size_t mid = beg + (end - beg) / 2;
+		struct netini_file *file = array_i(files, mid);
+
+		if ((is_host ? file->host : file->net) <= i)
+			beg = mid;
+		else
+			end = mid;
+	}
+	return ((struct netini_file *)array_i(files, beg))->path;
+}
+
+static char const *
+host_path(struct array *files, size_t i)
+{
+	return lint_path(files, i, 1);
+}
+
+static char const *
+net_path(struct array *files, size_t i)
+{
+	return lint_path(files, i, 0);
+}
+
+static int
+lint_ip_cmp(void const *v1, void const *v2)
+{
+	struct lint_ip const *a = v1, *b = v2;
+	int i;
+
+	if ((i = memcmp(a->ip, b->ip, sizeof a->ip)) != 0)
+		return i;
+	return (a->host > b->host) - (a->host < b->host);
+}
+
+static int
+lint_mac_cmp(void const *v1, void const *v2)
+{
+	struct lint_mac const *a = v1, *b = v2;
+	int i;
+
+	if ((i = memcmp(a->mac, b->mac, sizeof a->mac)) != 0)
+		return i;
+	return (a->host > b->host) - (a->host < b->host);
+}
+
+static struct lint_ip *
+sort_ips(struct netini_graph *graph, size_t *np, struct mem_pool *pool)
+{
+	struct lint_ip *ips;
+	size_t n = 0;
+
+	for (size_t i = 0; i < array_length(&graph->hosts); i++)
+		n += array_length(&((struct netini_host *)array_i(&graph->hosts, i))->ips);
+	if ((ips = mem_alloc(pool, n * sizeof *ips + 1)) == NULL)
+		die("msg=","sorting ips");
+
+	n = 0;
+	for (size_t i = 0; i < array_length(&graph->hosts); i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		for (size_t i2 = 0; i2 < array_length(&host->ips); i2++, n++) {
+			memcpy(ips[n].ip, array_i(&host->ips, i2), 16);
+			ips[n].host = i;
+		}
+	}
+	qsort(ips, n, sizeof *ips, lint_ip_cmp);
+	*np = n;
+	return ips;
+}
+
+static struct lint_mac *
+sort_macs(struct netini_graph *graph, size_t *np, struct mem_pool *pool)
+{
+	struct lint_mac *macs;
+	size_t n = 0;
+
+	for (size_t i = 0; i < array_length(&graph->hosts); i++)
+		n += array_length(&((struct netini_host *)array_i(&graph->hosts, i))->macs);
+	if ((macs = mem_alloc(pool, n * sizeof *macs + 1)) == NULL)
+		die("msg=","sorting macs");
+
+	n = 0;
+	for (size_t i = 0; i < array_length(&graph->hosts); i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		for (size_t i2 = 0; i2 < array_length(&host->macs); i2++, n++) {
+			memcpy(macs[n].mac, array_i(&host->macs, i2), 6);
+			macs[n].host = i;
+		}
+	}
+	qsort(macs, n, sizeof *macs, lint_mac_cmp);
+	*np = n;
+	return macs;
+}
+
+static void
+lint_duplicate_ips(struct netini_graph *graph, struct array *files,
+	struct lint_ip *ips, size_t n)
+{
+	char buf[IP_FMT_ADDR_LEN];
+
+	/* every other host is reported against the first one */
+	for (size_t i = 1, i0 = 0; i < n; i++) {
+		struct netini_host *host, *first;
+
+		if (memcmp(ips[i].ip, ips[i0].ip, 16) != 0) {
+			i0 = i;
+			continue;
+		}
+		if (ips[i].host == ips[i - 1].host)
+			continue;
+
+		host = array_i(&graph->hosts, ips[i].host);
+		first = array_i(&graph->hosts, ips[i0].host);
+		ip_fmt_addr(buf, ips[i].ip);
+		problem("msg=","duplicate ip", "ip=",buf,
+		  "host=",host->name, "path=",host_path(files, ips[i].host),
+		  "line=",fmt(host->section->ln), "first=",first->name, NULL);
+	}
+}
+
+static void
+lint_duplicate_macs(struct netini_graph *graph, struct array *files,
+	struct lint_mac *macs, size_t n)
+{
+	char buf[MAC_FMT_ADDR_LEN];
+
+	for (size_t i = 1, i0 = 0; i < n; i++) {
+		struct netini_host *host, *first;
+
+		if (memcmp(macs[i].mac, macs[i0].mac, 6) != 0) {
+			i0 = i;
+			continue;
+		}
+		if (macs[i].host == macs[i - 1].host)
+			continue;
+
+		host = array_i(&graph->hosts, macs[i].host);
+		first = array_i(&graph->hosts, macs[i0].host);
+		mac_fmt_addr(buf, macs[i].mac);
+		problem("msg=","duplicate mac", "mac=",buf,
+		  "host=",host->name, "path=",host_path(files, macs[i].host),
+		  "line=",fmt(host->section->ln), "first=",first->name, NULL);
+	}
+}
+
+/*
+ * As nets are either inside one another or apart, a net overlaps the
+ * others if it has a parent in the tree of nets, reported against the
+ * outermost one. The same net twice come one after the other in
+ * graph->spans.
+ */
+static void
+lint_overlapping_nets(struct netini_graph *graph, struct array *files)
+{
+	struct netini_span *spans = graph->spans;
+
+	for (size_t i = 1; i < array_length(&graph->nets); i++) {
+		struct netini_net *net, *other;
+		int same;
+
+		net = array_i(&graph->nets, spans[i].net);
+		if (net->parent == NETINI_NONE)
+			continue;
+
+		same = memcmp(spans[i].beg, spans[i - 1].beg, 16) == 0
+		  && memcmp(spans[i].end, spans[i - 1].end, 16) == 0;
+		if (!same && supernets)
+			continue;
+
+		if (same) {
+			other = array_i(&graph->nets, spans[i - 1].net);
+		} else {
+			other = array_i(&graph->nets, net->parent);
+			while (other->parent != NETINI_NONE)
+				other = array_i(&graph->nets, other->parent);
+		}
+		problem("msg=",same ? "duplicate net" : "overlapping net",
+		  "net=",net->name, "path=",net_path(files, spans[i].net),
+		  "line=",fmt(net->section->ln), "other=",other->name, NULL);
+	}
+}
+
+static void
+lint_ips_without_net(struct netini_graph *graph, struct array *files)
+{
+	char buf[IP_FMT_ADDR_LEN];
+
+	for (size_t i = 0; i < array_length(&graph->hosts); i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		for (size_t i2 = 0; i2 < array_length(&host->ips); i2++) {
+			uint8_t *ip = array_i(&host->ips, i2);
+
+			if (netini_find_net(graph, ip) != NETINI_NONE)
+				continue;
+			ip_fmt_addr(buf, ip);
+			problem("msg=","ip in no net", "ip=",buf,
+			  "host=",host->name, "path=",host_path(files, i),
+			  "line=",fmt(host->section->ln), NULL);
+		}
+	}
+}
+
+/*
+ * Binary search of the address at the start of the items sorted by it.
+ */
+static int
+sorted_has(void const *base, size_t n, size_t sz, void const *addr,
+	size_t len)
+{
+	size_t beg = 0, end = n;
+
+	while (beg < end) {
+		size_t mid = beg + (end - beg) / 2;
+		int i = memcmp((char const *)base + mid * sz, addr, len);
+
+		if (i == 0)
+			return 1;
+		if (i < 0)
+			beg = mid + 1;
+		else
+			end = mid;
+	}
+	return 0;
+}
+
+static void
+lint_unresolved_links(struct netini_graph *graph, struct array *files,
+	struct lint_ip *ips, size_t nips, struct lint_mac *macs, size_t nmacs,
+	struct mem_pool *pool)
+{
+	char buf[IP_FMT_ADDR_LEN];
+	struct hash names = {0};
+	size_t nhosts = array_length(&graph->hosts);
+
+	if (hash_init(&names, nhosts, pool) < 0)
+		die("msg=","indexing host names");
+	for (size_t i = 0; i < nhosts; i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+		void **value = hash_set(&names, host->name, strlen(host->name));
+
+		if (value == NULL)
+			die("msg=","indexing host names");
+		*value = host;
+	}
+
+	for (size_t i = 0; i < nhosts; i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		for (size_t i2 = 0; i2 < array_length(&host->links); i2++) {
+			struct netini_link *link = array_i(&host->links, i2);
+			char const *target = buf;
+			int found = 0;
+
+			switch (link->type) {
+			case NETINI_T_IP:
+				found = sorted_has(ips, nips, sizeof *ips,
+				  link->u.ip, 16);
+				ip_fmt_addr(buf, link->u.ip);
+				break;
+			case NETINI_T_MAC:
+				found = sorted_has(macs, nmacs, sizeof *macs,
+				  link->u.mac, 6);
+				mac_fmt_addr(buf, link->u.mac);
+				break;
+			case NETINI_T_NAME:
+				target = link->u.name;
+				found = hash_get(&names, target, strlen(target))
+				  != NULL;
+				break;
+			}
+			if (found)
+				continue;
+			problem("msg=","unresolved link", "link=",target,
+			  "host=",host->name, "path=",host_path(files, i),
+			  "line=",fmt(host->section->ln), NULL);
+		}
+	}
+	mem_delete(names.slots);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct mem_pool pool = {0};
+	struct netini_graph graph = {0};
+	struct lint_ip *ips;
+	struct lint_mac *macs;
+	char const *errstr;
+	char *pattern = "*.ini";
+	size_t nips, nmacs;
+	int c, err, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	arg0 = *argv;
+	while ((c = getopt(argc, argv, "sg:j:")) != -1) {
+		switch (c) {
+		case 's':
+			supernets = 1;
+			break;
+		case 'g':
+			pattern = optarg;
+			break;
+		case 'j':
+			nthreads = strtonum(optarg, 1, NETINI_THREADS_MAX, &errstr);
+			if (errstr != NULL)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (netini_init_graph(&graph, &pool) < 0)
+		die("msg=","initializing data");
+	graph.nthreads = nthreads;
+
+	if ((err = netini_load(&graph, argv, pattern, nthreads, &pool)) < 0)
+		die("msg=",netini_strerror(err), "path=",graph.failed.path,
+		  "line=",fmt(graph.failed.ln));
+
+	ips = sort_ips(&graph, &nips, &pool);
+	macs = sort_macs(&graph, &nmacs, &pool);
+	if (netini_net_tree(&graph) < 0)
+		die("msg=","sorting nets");
+
+	lint_duplicate_ips(&graph, &graph.files, ips, nips);
+	lint_duplicate_macs(&graph, &graph.files, macs, nmacs);
+	lint_overlapping_nets(&graph, &graph.files);
+	lint_ips_without_net(&graph, &graph.files);
+	lint_unresolved_links(&graph, &graph.files, ips, nips, macs, nmacs,
+	  &pool);
+
+	mem_free(&pool);
+	return (nproblems > 0);
+}
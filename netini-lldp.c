@@ -0,0 +1,510 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "ip.h"
+#include "load.h"
+#include "log.h"
+#include "mac.h"
+#include "mem.h"
+#include "netini.h"
+
+/*
+ * Import the LLDP and CDP neighbours of devices as the link= entries of
+ * one [host] per device, from lldpctl in the keyvalue or JSON format, or
+ * from the "show lldp neighbors detail" and "show cdp neighbors detail"
+ * of switches. Each neighbour is named by its system name, chassis MAC or
+ * management IP, the first one that matches a host of the inventory given
+ * with -i, which is looked up in the same hash index as the L2 edges use.
+ */
+
+#define LLDP_NAME_MAX 256
+#define LLDP_DEPTH_MAX 16
+
+static char *arg0;
+
+struct lldp_neighbour {
+	char name[LLDP_NAME_MAX];
+	char id_type[32];
+	char id[LLDP_NAME_MAX];
+	uint8_t ip[16];
+	int has_ip;
+};
+
+struct lldp_device {
+	struct netini_graph *graph; /* NULL without inventory */
+	char const *name;
+	struct array links; /* char *, written already */
+	struct mem_pool *pool;
+	size_t nmissing;
+};
+
+struct lldp_json {
+	FILE *fp;
+	char keys[LLDP_DEPTH_MAX][LLDP_NAME_MAX];
+	int depth;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-g pattern] [-i inventory] [-n name]"
+	  " [file...]\n", arg0);
+	exit(1);
+}
+
+/* MAC in any of the usual forms: 00:11:22:33:44:55, 0011.2233.4455... */
+static int
+lldp_mac(char const *s, uint8_t *mac)
+{
+	char hex[13];
+	size_t n = 0;
+
+	for (; *s != '\0'; s++) {
+		if (isxdigit((unsigned char)*s) && n < 12)
+			hex[n++] = *s;
+		else if (*s != ':' && *s != '-' && *s != '.')
+			return 0;
+	}
+	if (n != 12)
+		return 0;
+	hex[n] = '\0';
+	for (int i = 0; i < 6; i++) {
+		char byte[3] = { hex[i * 2], hex[i * 2 + 1], '\0' };
+
+		mac[i] = strtoul(byte, NULL, 16);
+	}
+	return 1;
+}
+
+/* whether a host of the inventory matches the link */
+static int
+lldp_known(struct lldp_device *dev, struct netini_link *link)
+{
+	size_t it = 0;
+
+	return netini_next_linked(dev->graph, link, &it) != NETINI_NONE;
+}
+
+static void
+lldp_write(struct lldp_device *dev, char const *value)
+{
+	size_t len = strlen(value);
+	char *copy;
+
+	/* several ports toward the same neighbour */
+	for (size_t i = 0; i < array_length(&dev->links); i++)
+		if (strcmp(*(char **)array_i(&dev->links, i), value) == 0)
+			return;
+	if ((copy = mem_alloc(dev->pool, len + 1)) == NULL
+	 || array_append(&dev->links, &copy) < 0)
+		die("msg=","adding a link");
+	memcpy(copy, value, len + 1);
+	printf("link = %s\n", value);
+}
+
+/*
+ * Link toward the neighbour by the first of its system name, the same
+ * without the domain, its chassis MAC and its management IP that a host
+ * of the inventory has, or the first one it has without an inventory.
+ */
+static void
+lldp_flush(struct lldp_device *dev, struct lldp_neighbour *nb)
+{
+	struct netini_link links[4];
+	char values[4][LLDP_NAME_MAX];
+	size_t n = 0;
+
+	if (nb->name[0] != '\0') {
+		links[n].type = NETINI_T_NAME;
+		links[n].u.name = strcpy(values[n], nb->name);
+		n++;
+		if (strchr(nb->name, '.') != NULL) {
+			links[n].type = NETINI_T_NAME;
+			links[n].u.name = values[n];
+			snprintf(values[n], sizeof values[n], "%.*s",
+			  (int)strcspn(nb->name, "."), nb->name);
+			n++;
+		}
+	}
+	if ((nb->id_type[0] == '\0' || strcmp(nb->id_type, "mac") == 0)
+	 && lldp_mac(nb->id, links[n].u.mac)) {
+		links[n].type = NETINI_T_MAC;
+		mac_fmt_addr(values[n], links[n].u.mac);
+		n++;
+	}
+	if (nb->has_ip) {
+		links[n].type = NETINI_T_IP;
+		memcpy(links[n].u.ip, nb->ip, 16);
+		ip_fmt_addr(values[n], nb->ip);
+		n++;
+	}
+	memset(nb, 0, sizeof *nb);
+	if (n == 0)
+		return;
+
+	if (dev->graph != NULL) {
+		for (size_t i = 0; i < n; i++) {
+			if (lldp_known(dev, &links[i])) {
+				lldp_write(dev, values[i]);
+				return;
+			}
+		}
+		errno = 0;
+		warn("msg=","neighbour not in the inventory", "device=",dev->name,
+		  "neighbour=",values[0]);
+		dev->nmissing++;
+	}
+	lldp_write(dev, values[0]);
+}
+
+static void
+lldp_ip(struct lldp_neighbour *nb, char const *s)
+{
+	char const *end;
+
+	if (nb->has_ip)
+		return;
+	if ((end = ip_parse_addr(s, nb->ip)) != NULL && *end == '\0')
+		nb->has_ip = 1;
+}
+
+static int
+lldp_suffix(char const *s, char const *suffix)
+{
+	size_t len = strlen(s), slen = strlen(suffix);
+
+	return len >= slen && strcmp(s + len - slen, suffix) == 0;
+}
+
+/*
+ * lldpctl -f keyvalue, one line per value, starting with the interface,
+ * where each neighbour begins with its "via" line:
+ *	lldp.eth0.via=LLDP
+ *	lldp.eth0.chassis.mac=00:11:22:33:44:55
+ *	lldp.eth0.chassis.name=sw1
+ *	lldp.eth0.chassis.mgmt-ip=192.0.2.1
+ */
+static void
+lldp_keyvalue(struct lldp_device *dev, struct lldp_neighbour *nb, char *line)
+{
+	char *value = strchr(line, '=');
+
+	if (value == NULL)
+		return;
+	*value++ = '\0';
+	value[strcspn(value, "\r\n")] = '\0';
+
+	if (lldp_suffix(line, ".via")) {
+		lldp_flush(dev, nb);
+	} else if (lldp_suffix(line, ".chassis.mac")) {
+		snprintf(nb->id, sizeof nb->id, "%s", value);
+		strcpy(nb->id_type, "mac");
+	} else if (lldp_suffix(line, ".chassis.name")) {
+		snprintf(nb->name, sizeof nb->name, "%s", value);
+	} else if (lldp_suffix(line, ".chassis.mgmt-ip")) {
+		lldp_ip(nb, value);
+	}
+}
+
+/*
+ * show lldp neighbors detail, or show cdp neighbors detail, with the
+ * neighbours separated by dashes:
+ *	Chassis id: 0011.2233.4455
+ *	System Name: sw1.example.com
+ *	    IP: 192.0.2.1
+ * or:
+ *	Device ID: sw1.example.com(FOC1234X0YZ)
+ *	  IP address: 192.0.2.1
+ */
+static void
+lldp_text(struct lldp_device *dev, struct lldp_neighbour *nb, char *line)
+{
+	char *key = line + strspn(line, " \t"), *value;
+
+	if (strncmp(key, "---", 3) == 0) {
+		lldp_flush(dev, nb);
+		return;
+	}
+	if ((value = strchr(key, ':')) == NULL)
+		return;
+	*value++ = '\0';
+	value += strspn(value, " \t");
+	value[strcspn(value, " \t\r\n")] = '\0';
+
+	if (strcasecmp(key, "Chassis id") == 0) {
+		snprintf(nb->id, sizeof nb->id, "%s", value);
+	} else if (strcasecmp(key, "System Name") == 0
+	 || strcasecmp(key, "Device ID") == 0) {
+		value[strcspn(value, "(")] = '\0';
+		snprintf(nb->name, sizeof nb->name, "%s", value);
+	} else if (strcasecmp(key, "IP") == 0
+	 || strcasecmp(key, "IP address") == 0
+	 || strcasecmp(key, "IPv4 address") == 0
+	 || strcasecmp(key, "IPv6 address") == 0) {
+		lldp_ip(nb, value);
+	}
+}
+
+/*
+ * Value found in lldpctl -f json, under keys such as:
+ *	lldp interface eth0 chassis sw1 id value
+ *	lldp interface eth0 chassis sw1 mgmt-ip
+ * where the name of the chassis is left out when it has none.
+ */
+static void
+lldp_json_value(struct lldp_json *j, struct lldp_neighbour *nb,
+	char const *value)
+{
+	char (*k)[LLDP_NAME_MAX] = j->keys + 4;
+	int n = j->depth - 4;
+
+	if (j->depth < 5 || strcmp(j->keys[0], "lldp") != 0
+	 || strcmp(j->keys[1], "interface") != 0
+	 || strcmp(j->keys[3], "chassis") != 0)
+		return;
+	if (strcmp(k[0], "id") != 0 && strcmp(k[0], "mgmt-ip") != 0
+	 && strcmp(k[0], "name") != 0 && n > 1) {
+		snprintf(nb->name, sizeof nb->name, "%s", k[0]);
+		k++, n--;
+	}
+
+	if (n == 2 && strcmp(k[0], "id") == 0 && strcmp(k[1], "type") == 0)
+		snprintf(nb->id_type, sizeof nb->id_type, "%s", value);
+	else if (n == 2 && strcmp(k[0], "id") == 0 && strcmp(k[1], "value") == 0)
+		snprintf(nb->id, sizeof nb->id, "%s", value);
+	else if (n == 1 && strcmp(k[0], "mgmt-ip") == 0)
+		lldp_ip(nb, value);
+	else if (n == 1 && strcmp(k[0], "name") == 0)
+		snprintf(nb->name, sizeof nb->name, "%s", value);
+}
+
+static int
+lldp_json_space(FILE *fp)
+{
+	int c;
+
+	while ((c = getc(fp)) != EOF && isspace(c))
+		continue;
+	return c;
+}
+
+/* string after its opening quote, truncated to sz, with escapes resolved */
+static int
+lldp_json_string(FILE *fp, char *buf, size_t sz)
+{
+	size_t n = 0;
+	int c;
+
+	while ((c = getc(fp)) != '"') {
+		if (c == EOF)
+			return -1;
+		if (c == '\\') {
+			switch (c = getc(fp)) {
+			case 'n': c = '\n'; break;
+			case 't': c = '\t'; break;
+			case 'u':
+				for (int i = 0; i < 4; i++)
+					if (!isxdigit(getc(fp)))
+						return -1;
+				c = '?';
+				break;
+			case EOF:
+				return -1;
+			}
+		}
+		if (n + 1 < sz)
+			buf[n++] = c;
+	}
+	buf[n] = '\0';
+	return 0;
+}
+
+/*
+ * Walk a JSON value starting with c, keeping the keys leading to it, and
+ * flushing a neighbour at the end of each interface.
+ */
+static int
+lldp_json_walk(struct lldp_device *dev, struct lldp_neighbour *nb,
+	struct lldp_json *j, int c)
+{
+	char value[LLDP_NAME_MAX];
+	size_t n = 0;
+
+	switch (c) {
+	case '{':
+		if ((c = lldp_json_space(j->fp)) == '}')
+			break;
+		for (;; c = lldp_json_space(j->fp)) {
+			char key[LLDP_NAME_MAX];
+
+			if (c != '"' || lldp_json_string(j->fp, key, sizeof key) < 0
+			 || lldp_json_space(j->fp) != ':')
+				return -1;
+			if (j->depth < LLDP_DEPTH_MAX)
+				strcpy(j->keys[j->depth], key);
+			j->depth++;
+			if (lldp_json_walk(dev, nb, j, lldp_json_space(j->fp)) < 0)
+				return -1;
+			if (j->depth == 3 && strcmp(j->keys[0], "lldp") == 0
+			 && strcmp(j->keys[1], "interface") == 0)
+				lldp_flush(dev, nb);
+			j->depth--;
+			if ((c = lldp_json_space(j->fp)) == '}')
+				break;
+			if (c != ',')
+				return -1;
+		}
+		break;
+	case '[':
+		if ((c = lldp_json_space(j->fp)) == ']')
+			break;
+		for (;; c = lldp_json_space(j->fp)) {
+			if (lldp_json_walk(dev, nb, j, c) < 0)
+				return -1;
+			if ((c = lldp_json_space(j->fp)) == ']')
+				break;
+			if (c != ',')
+				return -1;
+		}
+		break;
+	case '"':
+		if (lldp_json_string(j->fp, value, sizeof value) < 0)
+			return -1;
+		if (j->depth <= LLDP_DEPTH_MAX)
+			lldp_json_value(j, nb, value);
+		break;
+	default:
+		/* number, true, false or null */
+		for (; c != EOF && (isalnum(c) || strchr("+-.", c)); c = getc(j->fp))
+			if (n + 1 < sizeof value)
+				value[n++] = c;
+		if (n == 0)
+			return -1;
+		ungetc(c, j->fp);
+		value[n] = '\0';
+		if (j->depth <= LLDP_DEPTH_MAX)
+			lldp_json_value(j, nb, value);
+	}
+	return 0;
+}
+
+static void
+lldp_parse_file(struct lldp_device *dev, char const *path)
+{
+	struct lldp_neighbour nb = {0};
+	char *line = NULL;
+	size_t sz = 0;
+	FILE *fp;
+	int c;
+
+	fp = (strcmp(path, "/dev/stdin") == 0) ? stdin : fopen(path, "r");
+	if (fp == NULL)
+		die("msg=","opening input", "path=",path);
+
+	if ((c = lldp_json_space(fp)) == '{') {
+		struct lldp_json *j;
+
+		if ((j = mem_alloc(dev->pool, sizeof *j)) == NULL)
+			die("msg=","reading input", "path=",path);
+		j->fp = fp;
+		if (lldp_json_walk(dev, &nb, j, c) < 0)
+			die("msg=","invalid JSON", "path=",path);
+		mem_delete(j);
+	} else {
+		ungetc(c, fp);
+		while (getline(&line, &sz, fp) > 0) {
+			if (strncmp(line, "lldp.", 5) == 0)
+				lldp_keyvalue(dev, &nb, line);
+			else
+				lldp_text(dev, &nb, line);
+		}
+	}
+	if (ferror(fp))
+		die("msg=","reading input", "path=",path);
+	lldp_flush(dev, &nb);
+
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+}
+
+int
+main(int argc, char **argv)
+{
+	static char buf[1 << 16];
+	struct mem_pool pool = {0};
+	struct netini_graph graph = {0};
+	struct lldp_device dev = {0};
+	char **inventory, *pattern = "*.ini", *name = NULL;
+	size_t ninventory = 0;
+	int c, err, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	arg0 = *argv;
+	if ((inventory = mem_alloc(&pool, argc * sizeof *inventory)) == NULL)
+		die("msg=","parsing arguments");
+	while ((c = getopt(argc, argv, "g:i:n:")) != -1) {
+		switch (c) {
+		case 'g':
+			pattern = optarg;
+			break;
+		case 'i':
+			inventory[ninventory++] = optarg;
+			break;
+		case 'n':
+			name = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (ninventory > 0) {
+		if (netini_init_graph(&graph, &pool) < 0)
+			die("msg=","initializing data");
+		graph.nthreads = nthreads;
+		if ((err = netini_load(&graph, inventory, pattern, nthreads, &pool)) < 0)
+			die("msg=",netini_strerror(err), "path=",graph.failed.path,
+			  "line=",fmt(graph.failed.ln));
+		if (netini_index_links(&graph) < 0)
+			die("msg=","indexing hosts");
+		dev.graph = &graph;
+	}
+	dev.pool = &pool;
+
+	setvbuf(stdout, buf, _IOFBF, sizeof buf);
+	if (*argv == NULL && name == NULL)
+		die("msg=","-n is needed to read the standard input");
+	if (*argv == NULL)
+		*--argv = "-";
+	for (int first = 1; *argv != NULL; argv++, first = 0) {
+		int in = (strcmp(*argv, "-") == 0);
+
+		if (in && name == NULL)
+			die("msg=","-n is needed to read the standard input");
+		dev.name = in ? name : load_name(*argv, &pool);
+		if (dev.name == NULL)
+			die("msg=","naming devices");
+		if (array_init(&dev.links, sizeof(char *), &pool) < 0)
+			die("msg=","initializing data");
+		if (!first)
+			putchar('\n');
+		printf("[host]\nname = %s\n", dev.name);
+		lldp_parse_file(&dev, in ? "/dev/stdin" : *argv);
+		mem_delete(dev.links.mem);
+		dev.links.init = 0;
+	}
+
+	if (fflush(stdout) == EOF)
+		die("msg=","writing output");
+	mem_free(&pool);
+	return 0;
+}
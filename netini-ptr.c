@@ -0,0 +1,407 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "compat.h"
+#include "hash.h"
+#include "ip.h"
+#include "load.h"
+#include "log.h"
+#include "mem.h"
+
+/*
+ * Import the PTR records of zone files in the format of BIND as [host]
+ * sections. The files are read one record at a time, so that only the
+ * record being read is held in memory, unless the hosts are merged by
+ * name with -m.
+ */
+
+#define PTR_NAME_MAX 1024
+#define PTR_TOKENS_MAX 8
+#define PTR_INCLUDE_MAX 16
+
+static char *arg0;
+static char const *domain;
+static int merge;
+
+struct ptr_host {
+	char *name;
+	struct array ips; /* uint8_t[16] */
+};
+
+struct ptr_state {
+	struct array hosts; /* struct ptr_host, with -m */
+	struct hash names; /* char *name -> struct ptr_host index + 1, with -m */
+	char last[PTR_NAME_MAX]; /* name of the section written last */
+	uint8_t lastip[16];
+	struct mem_pool *pool;
+	size_t nrecords, nskipped;
+};
+
+struct ptr_file {
+	char const *path;
+	size_t ln;
+	char origin[PTR_NAME_MAX]; /* lowercase, without the trailing dot */
+	char owner[PTR_NAME_MAX];
+	int depth;
+	int level; /* of $INCLUDE */
+};
+
+static void ptr_parse_file(struct ptr_state *state, char const *path,
+	char const *origin, int level);
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-m] [-d domain] [-z origin] [file...]\n",
+	  arg0);
+	exit(1);
+}
+
+/*
+ * Absolute name for s as found in the file, without the trailing dot, or
+ * NULL if it does not fit.
+ */
+static char *
+ptr_name(char *buf, char const *s, char const *origin)
+{
+	size_t len = strlen(s);
+	int n;
+
+	if (strcmp(s, "@") == 0)
+		n = snprintf(buf, PTR_NAME_MAX, "%s", origin);
+	else if (len > 0 && s[len - 1] == '.')
+		n = snprintf(buf, PTR_NAME_MAX, "%.*s", (int)len - 1, s);
+	else if (*origin == '\0')
+		n = snprintf(buf, PTR_NAME_MAX, "%s", s);
+	else
+		n = snprintf(buf, PTR_NAME_MAX, "%s.%s", s, origin);
+	return (n < 0 || n >= PTR_NAME_MAX) ? NULL : buf;
+}
+
+static void
+ptr_lower(char *s)
+{
+	for (; *s != '\0'; s++)
+		*s = tolower((unsigned char)*s);
+}
+
+/* name of the host for an absolute name: short if in domain, dotted if not */
+static char *
+ptr_host_name(char *buf, char const *name)
+{
+	size_t len = strlen(name), dlen = (domain == NULL) ? 0 : strlen(domain);
+
+	if (domain != NULL && len > dlen && name[len - dlen - 1] == '.'
+	 && strcasecmp(name + len - dlen, domain) == 0)
+		snprintf(buf, PTR_NAME_MAX, "%.*s", (int)(len - dlen - 1), name);
+	else
+		snprintf(buf, PTR_NAME_MAX, "%s.", name);
+	return buf;
+}
+
+static void
+ptr_write_ip(uint8_t *ip)
+{
+	char buf[IP_FMT_ADDR_LEN];
+
+	ip_fmt_addr(buf, ip);
+	fputs("ip = ", stdout);
+	fputs(buf, stdout);
+	putchar('\n');
+}
+
+static void
+ptr_write_host(char const *name, int first)
+{
+	if (!first)
+		putchar('\n');
+	fputs("[host]\nname = ", stdout);
+	fputs(name, stdout);
+	putchar('\n');
+}
+
+static void
+ptr_add(struct ptr_state *state, char const *name, uint8_t *ip)
+{
+	struct ptr_host *host, new = {0};
+	size_t len = strlen(name);
+	void *vp, **slot;
+
+	if (!merge) {
+		/* the records of the same name in a row make one host */
+		if (strcmp(state->last, name) != 0)
+			ptr_write_host(name, state->last[0] == '\0');
+		else if (memcmp(state->lastip, ip, 16) == 0)
+			return;
+		ptr_write_ip(ip);
+		strlcpy(state->last, name, sizeof state->last);
+		memcpy(state->lastip, ip, 16);
+		return;
+	}
+
+	if ((vp = hash_get(&state->names, name, len)) == NULL) {
+		/* the keys are not copied, so the copy is the key */
+		if ((new.name = mem_alloc(state->pool, len + 1)) == NULL
+		 || array_init(&new.ips, 16, state->pool) < 0
+		 || array_append(&state->hosts, &new) < 0)
+			die("msg=","adding a host");
+		memcpy(new.name, name, len + 1);
+		if ((slot = hash_set(&state->names, new.name, len)) == NULL)
+			die("msg=","adding a host");
+		*slot = vp = (void *)(uintptr_t)array_length(&state->hosts);
+	}
+	host = array_i(&state->hosts, (uintptr_t)vp - 1);
+	for (size_t i = 0; i < array_length(&host->ips); i++)
+		if (memcmp(array_i(&host->ips, i), ip, 16) == 0)
+			return;
+	if (array_append(&host->ips, ip) < 0)
+		die("msg=","adding an ip");
+}
+
+static void
+ptr_record(struct ptr_state *state, struct ptr_file *file, char **tok,
+	size_t ntok)
+{
+	char owner[PTR_NAME_MAX], target[PTR_NAME_MAX], name[PTR_NAME_MAX];
+	uint8_t ip[16];
+	size_t i = 0;
+	char const *end;
+	int mask;
+
+	for (int n = 0; n < 2 && i < ntok; n++, i++)
+		if (!isdigit((unsigned char)tok[i][0]) && strcasecmp(tok[i], "IN") != 0
+		 && strcasecmp(tok[i], "CH") != 0 && strcasecmp(tok[i], "HS") != 0
+		 && strcasecmp(tok[i], "CS") != 0)
+			break;
+	if (i + 1 >= ntok || strcasecmp(tok[i], "PTR") != 0)
+		return;
+	state->nrecords++;
+
+	strlcpy(owner, file->owner, sizeof owner);
+	ptr_lower(owner);
+	end = ip_parse_in_addr_arpa(owner, ip, &mask);
+	if (end == NULL)
+		end = ip_parse_ip6_arpa(owner, ip, &mask);
+	if (end == NULL || mask != 128) {
+		errno = 0;
+		warn("msg=","not the name of an address, skipped",
+		  "owner=",file->owner, "path=",file->path, "line=",fmt(file->ln));
+		state->nskipped++;
+		return;
+	}
+	if (ptr_name(target, tok[i + 1], file->origin) == NULL) {
+		errno = 0;
+		warn("msg=","name too long, skipped",
+		  "path=",file->path, "line=",fmt(file->ln));
+		state->nskipped++;
+		return;
+	}
+	ptr_add(state, ptr_host_name(name, target), ip);
+}
+
+static void
+ptr_directive(struct ptr_state *state, struct ptr_file *file, char **tok,
+	size_t ntok)
+{
+	char buf[PTR_NAME_MAX];
+
+	if (strcasecmp(tok[0], "$ORIGIN") == 0 && ntok > 1) {
+		if (ptr_name(buf, tok[1], file->origin) == NULL)
+			die("msg=","origin too long", "path=",file->path,
+			  "line=",fmt(file->ln));
+		ptr_lower(buf);
+		strlcpy(file->origin, buf, sizeof file->origin);
+	} else if (strcasecmp(tok[0], "$INCLUDE") == 0 && ntok > 1) {
+		char const *origin = file->origin;
+
+		if (ntok > 2) {
+			if (ptr_name(buf, tok[2], file->origin) == NULL)
+				die("msg=","origin too long", "path=",file->path,
+				  "line=",fmt(file->ln));
+			ptr_lower(buf);
+			origin = buf;
+		}
+		ptr_parse_file(state, tok[1], origin, file->level + 1);
+	} else if (strcasecmp(tok[0], "$TTL") != 0) {
+		errno = 0;
+		warn("msg=","directive not supported, skipped", "directive=",tok[0],
+		  "path=",file->path, "line=",fmt(file->ln));
+	}
+}
+
+/*
+ * Split a whole record into tokens, in place, for the ones in front that
+ * tell its type, and the one after.
+ */
+static void
+ptr_split(struct ptr_state *state, struct ptr_file *file, char *rec)
+{
+	char *tok[PTR_TOKENS_MAX];
+	size_t ntok;
+	int inherit = isspace((unsigned char)*rec);
+
+	ntok = load_split(rec, " \t\r\n", tok, PTR_TOKENS_MAX);
+	if (ntok == 0)
+		return;
+
+	if (tok[0][0] == '$' && !inherit) {
+		ptr_directive(state, file, tok, ntok);
+		return;
+	}
+	if (!inherit) {
+		if (ptr_name(file->owner, tok[0], file->origin) == NULL)
+			die("msg=","owner too long", "path=",file->path,
+			  "line=",fmt(file->ln));
+		ptr_record(state, file, tok + 1, ntok - 1);
+	} else {
+		ptr_record(state, file, tok, ntok);
+	}
+}
+
+/*
+ * Remove the comment of the line, and turn the parentheses into spaces,
+ * counting them in file->depth, as they let a record span several lines.
+ */
+static void
+ptr_strip(struct ptr_file *file, char *s)
+{
+	int quoted = 0;
+
+	for (; *s != '\0'; s++) {
+		if (*s == '\\' && s[1] != '\0') {
+			s++;
+		} else if (*s == '"') {
+			quoted = !quoted;
+		} else if (quoted) {
+			continue;
+		} else if (*s == ';') {
+			*s = '\0';
+			break;
+		} else if (*s == '(') {
+			file->depth++;
+			*s = ' ';
+		} else if (*s == ')') {
+			if (file->depth > 0)
+				file->depth--;
+			*s = ' ';
+		}
+	}
+}
+
+static void
+ptr_parse_file(struct ptr_state *state, char const *path, char const *origin,
+	int level)
+{
+	struct ptr_file file = {0};
+	struct mem_pool pool = {0};
+	char *line = NULL, *rec;
+	size_t sz = 0;
+	FILE *fp;
+
+	if (level > PTR_INCLUDE_MAX)
+		die("msg=","too many nested includes", "path=",path);
+	fp = (strcmp(path, "/dev/stdin") == 0) ? stdin : fopen(path, "r");
+	if (fp == NULL)
+		die("msg=","opening input", "path=",path);
+	if ((rec = mem_alloc(&pool, 0)) == NULL)
+		die("msg=","reading input");
+
+	file.path = path;
+	file.level = level;
+	strlcpy(file.origin, origin, sizeof file.origin);
+	while (getline(&line, &sz, fp) > 0) {
+		file.ln++;
+		ptr_strip(&file, line);
+		if (file.depth == 0 && mem_length(rec) == 0) {
+			ptr_split(state, &file, line);
+			continue;
+		}
+
+		/* a record in parentheses, kept until they are all closed */
+		if (mem_append((void **)&rec, line, strlen(line)) < 0)
+			die("msg=","reading input", "path=",path);
+		if (file.depth > 0)
+			continue;
+		if (mem_append((void **)&rec, "", 1) < 0)
+			die("msg=","reading input", "path=",path);
+		ptr_split(state, &file, rec);
+		if (mem_shrink((void **)&rec, mem_length(rec)) < 0)
+			die("msg=","reading input", "path=",path);
+	}
+	if (ferror(fp))
+		die("msg=","reading input", "path=",path);
+
+	free(line);
+	mem_free(&pool);
+	if (fp != stdin)
+		fclose(fp);
+}
+
+int
+main(int argc, char **argv)
+{
+	static char buf[1 << 16];
+	struct mem_pool pool = {0};
+	struct ptr_state state = {0};
+	char const *origin = "";
+	char zone[PTR_NAME_MAX];
+	int c;
+
+	arg0 = *argv;
+	while ((c = getopt(argc, argv, "md:z:")) != -1) {
+		switch (c) {
+		case 'm':
+			merge = 1;
+			break;
+		case 'd':
+			domain = optarg;
+			break;
+		case 'z':
+			origin = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (ptr_name(zone, origin, "") == NULL)
+		die("msg=","origin too long");
+	ptr_lower(zone);
+
+	state.pool = &pool;
+	if (array_init(&state.hosts, sizeof(struct ptr_host), &pool) < 0
+	 || hash_init(&state.names, 0, &pool) < 0)
+		die("msg=","initializing data");
+
+	setvbuf(stdout, buf, _IOFBF, sizeof buf);
+	if (*argv == NULL)
+		ptr_parse_file(&state, "/dev/stdin", zone, 0);
+	for (; *argv != NULL; argv++)
+		ptr_parse_file(&state, (strcmp(*argv, "-") == 0) ? "/dev/stdin"
+		  : *argv, zone, 0);
+
+	for (size_t i = 0; i < array_length(&state.hosts); i++) {
+		struct ptr_host *host = array_i(&state.hosts, i);
+
+		ptr_write_host(host->name, i == 0);
+		for (size_t i2 = 0; i2 < array_length(&host->ips); i2++)
+			ptr_write_ip(array_i(&host->ips, i2));
+	}
+
+	if (fflush(stdout) == EOF)
+		die("msg=","writing output");
+	if (state.nskipped > 0)
+		info("msg=","some records skipped", "records=",fmt(state.nrecords),
+		  "skipped=",fmt(state.nskipped));
+	mem_free(&pool);
+	return 0;
+}
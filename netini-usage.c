@@ -0,0 +1,392 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compat.h"
+#include "conf.h"
+#include "ip.h"
+#include "log.h"
+#include "mem.h"
+#include "netini.h"
+
+/*
+ * Use of the address space of every net: the IPs of the hosts are put in
+ * the smallest net holding them, and what is left of each net after its
+ * IPs and the nets inside of it is cut into CIDR blocks. The addresses are
+ * never enumerated, so that it works the same for IPv6.
+ */
+
+static char *arg0;
+static int summary;
+
+/* number of addresses, up to 2^128 included, least significant word first */
+struct count {
+	uint32_t w[5];
+};
+
+struct usage_ip {
+	size_t span; /* position of the net in graph->spans */
+	uint8_t ip[16];
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-s] [-g pattern] [-j threads] [file...]\n",
+	  arg0);
+	exit(1);
+}
+
+/* end - beg + 1, for beg <= end */
+static void
+count_range(struct count *c, uint8_t const *beg, uint8_t const *end)
+{
+	uint64_t borrow = 0, carry = 1;
+
+	for (int i = 0; i < 4; i++) {
+		uint32_t b = 0, e = 0;
+		uint64_t v;
+
+		for (int k = 0; k < 4; k++) {
+			b |= (uint32_t)beg[15 - i * 4 - k] << (k * 8);
+			e |= (uint32_t)end[15 - i * 4 - k] << (k * 8);
+		}
+		v = (uint64_t)e - b - borrow;
+		borrow = (v >> 63) & 1;
+		v = (v & 0xffffffff) + carry;
+		carry = v >> 32;
+		c->w[i] = v;
+	}
+	c->w[4] = carry;
+}
+
+static void
+count_add(struct count *c, struct count const *add)
+{
+	uint64_t carry = 0;
+
+	for (int i = 0; i < 5; i++) {
+		uint64_t v = (uint64_t)c->w[i] + add->w[i] + carry;
+
+		c->w[i] = v;
+		carry = v >> 32;
+	}
+}
+
+/* c - sub, with sub <= c */
+static void
+count_sub(struct count *c, struct count const *sub)
+{
+	uint64_t borrow = 0;
+
+	for (int i = 0; i < 5; i++) {
+		uint64_t v = (uint64_t)c->w[i] - sub->w[i] - borrow;
+
+		c->w[i] = v;
+		borrow = (v >> 63) & 1;
+	}
+}
+
+static char *
+count_fmt(char *buf, size_t sz, struct count const *c)
+{
+	struct count n = *c;
+	char *s = buf + sz;
+	int zero;
+
+	*--s = '\0';
+	do {
+		uint64_t rem = 0;
+
+		zero = 1;
+		for (int i = 4; i >= 0; i--) {
+			uint64_t v = (rem << 32) | n.w[i];
+
+			n.w[i] = v / 10;
+			rem = v % 10;
+			if (n.w[i] != 0)
+				zero = 0;
+		}
+		*--s = '0' + rem;
+	} while (!zero);
+	return s;
+}
+
+/* number of trailing zero bits of ip, 128 for all zeroes */
+static int
+ip_trailing_zeroes(uint8_t const *ip)
+{
+	int n = 0;
+
+	for (int i = 15; i >= 0; i--) {
+		if (ip[i] != 0) {
+			for (uint8_t b = ip[i]; (b & 1) == 0; b >>= 1)
+				n++;
+			return n;
+		}
+		n += 8;
+	}
+	return n;
+}
+
+/* position of the highest bit set of c, which is not zero */
+static int
+count_log2(struct count const *c)
+{
+	for (int i = 4; i >= 0; i--)
+		if (c->w[i] != 0)
+			for (int b = 31; b >= 0; b--)
+				if (c->w[i] >> b & 1)
+					return i * 32 + b;
+	return -1;
+}
+
+/* ip += 2^bits, returning 1 if it wraps around */
+static int
+ip_add_pow2(uint8_t *ip, int bits)
+{
+	unsigned carry = 1u << (bits % 8);
+
+	for (int i = 15 - bits / 8; i >= 0 && carry != 0; i--) {
+		carry += ip[i];
+		ip[i] = carry;
+		carry >>= 8;
+	}
+	return carry != 0;
+}
+
+static void
+print_prefix(char const *key, uint8_t const *ip, int mask)
+{
+	char buf[IP_FMT_ADDR_LEN];
+
+	ip_fmt_addr(buf, (uint8_t *)ip);
+	if (ip_version((uint8_t *)ip) == 4)
+		mask -= 96;
+	printf(" %s%s/%d", key, buf, mask);
+}
+
+/*
+ * Print the range from beg to end as the fewest CIDR blocks: each starts
+ * with the largest block aligned on beg and not past end.
+ */
+static void
+print_free(char const *name, uint8_t const *beg, uint8_t const *end)
+{
+	char buf[64];
+	uint8_t ip[16];
+
+	memcpy(ip, beg, 16);
+	for (;;) {
+		struct count left, size = {{0}};
+		int bits, log2;
+
+		count_range(&left, ip, end);
+		bits = ip_trailing_zeroes(ip);
+		if ((log2 = count_log2(&left)) < bits)
+			bits = log2;
+		size.w[bits / 32] = 1u << (bits % 32);
+
+		printf("net=%s", name);
+		print_prefix("free=", ip, 128 - bits);
+		printf(" size=%s\n", count_fmt(buf, sizeof buf, &size));
+
+		if (bits == log2 && memcmp(left.w, size.w, sizeof size.w) == 0)
+			break;
+		if (ip_add_pow2(ip, bits))
+			break;
+	}
+}
+
+static int
+usage_ip_cmp(void const *v1, void const *v2)
+{
+	struct usage_ip const *a = v1, *b = v2;
+
+	if (a->span != b->span)
+		return (a->span > b->span) - (a->span < b->span);
+	return memcmp(a->ip, b->ip, sizeof a->ip);
+}
+
+/*
+ * The host IPs sorted by the position of their smallest net among the
+ * sorted nets, and then by address, with the IPs in no net left out.
+ */
+static struct usage_ip *
+sort_ips(struct netini_graph *graph, size_t const *span, size_t *np,
+	struct mem_pool *pool)
+{
+	struct usage_ip *ips;
+	size_t n = 0;
+
+	for (size_t i = 0; i < array_length(&graph->hosts); i++)
+		n += array_length(&((struct netini_host *)array_i(&graph->hosts, i))->ips);
+	if ((ips = mem_alloc(pool, n * sizeof *ips + 1)) == NULL)
+		die("msg=","sorting ips");
+
+	n = 0;
+	for (size_t i = 0; i < array_length(&graph->hosts); i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		for (size_t i2 = 0; i2 < array_length(&host->ips); i2++) {
+			uint8_t *ip = array_i(&host->ips, i2);
+			size_t net = netini_find_net(graph, ip);
+
+			if (net == NETINI_NONE)
+				continue;
+			ips[n].span = span[net];
+			memcpy(ips[n++].ip, ip, 16);
+		}
+	}
+	qsort(ips, n, sizeof *ips, usage_ip_cmp);
+	*np = n;
+	return ips;
+}
+
+/*
+ * Walk the IPs and the nets right inside the net, both in the order of
+ * their address, counting them, or printing the gaps between them.
+ */
+static void
+walk_net(struct netini_graph *graph, size_t const *span, size_t pos,
+	struct usage_ip *ips, size_t nips, struct count *used,
+	struct count *subnets)
+{
+	struct netini_span *s = &graph->spans[pos];
+	struct netini_net *net = array_i(&graph->nets, s->net);
+	struct count one = {{1}};
+	uint8_t cursor[16];
+	size_t child = net->child, i = 0;
+	int wrapped = 0;
+
+	memcpy(cursor, s->beg, 16);
+	while (i < nips || child != NETINI_NONE) {
+		uint8_t const *beg, *end;
+		struct count c;
+
+		if (child != NETINI_NONE && (i == nips
+		 || memcmp(graph->spans[span[child]].beg, ips[i].ip, 16) < 0)) {
+			beg = graph->spans[span[child]].beg;
+			end = graph->spans[span[child]].end;
+			child = ((struct netini_net *)array_i(&graph->nets, child))->next;
+			count_range(&c, beg, end);
+		} else {
+			beg = end = ips[i++].ip;
+			c = one;
+		}
+
+		/* the same net twice, or the same IP on several hosts */
+		if (wrapped || memcmp(beg, cursor, 16) < 0)
+			continue;
+
+		if (used != NULL) {
+			count_add((beg == end) ? used : subnets, &c);
+		} else if (memcmp(beg, cursor, 16) > 0) {
+			uint8_t last[16];
+			int k = 15;
+
+			memcpy(last, beg, 16);
+			for (; last[k] == 0; k--)
+				last[k] = 0xff;
+			last[k]--;
+			print_free(net->name, cursor, last);
+		}
+		memcpy(cursor, end, 16);
+		wrapped = ip_add_pow2(cursor, 0);
+	}
+	if (used == NULL && !wrapped && memcmp(cursor, s->end, 16) <= 0)
+		print_free(net->name, cursor, s->end);
+}
+
+static void
+report_net(struct netini_graph *graph, size_t const *span, size_t pos,
+	struct usage_ip *ips, size_t nips)
+{
+	struct netini_span *s = &graph->spans[pos];
+	struct netini_net *net = array_i(&graph->nets, s->net);
+	struct count size, used = {{0}}, subnets = {{0}};
+	char buf[64];
+
+	walk_net(graph, span, pos, ips, nips, &used, &subnets);
+
+	count_range(&size, s->beg, s->end);
+	printf("net=%s", net->name);
+	print_prefix("ip=", s->beg, net->mask);
+	printf(" size=%s", count_fmt(buf, sizeof buf, &size));
+	printf(" used=%s", count_fmt(buf, sizeof buf, &used));
+	printf(" subnets=%s", count_fmt(buf, sizeof buf, &subnets));
+	count_sub(&size, &used);
+	count_sub(&size, &subnets);
+	printf(" free=%s\n", count_fmt(buf, sizeof buf, &size));
+
+	if (!summary)
+		walk_net(graph, span, pos, ips, nips, NULL, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct mem_pool pool = {0};
+	struct netini_graph graph = {0};
+	struct usage_ip *ips;
+	size_t *span, nips, nnets, i;
+	char const *errstr;
+	char *pattern = "*.ini";
+	int c, err, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	arg0 = *argv;
+	while ((c = getopt(argc, argv, "sg:j:")) != -1) {
+		switch (c) {
+		case 's':
+			summary = 1;
+			break;
+		case 'g':
+			pattern = optarg;
+			break;
+		case 'j':
+			nthreads = strtonum(optarg, 1, NETINI_THREADS_MAX, &errstr);
+			if (errstr != NULL)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (netini_init_graph(&graph, &pool) < 0)
+		die("msg=","initializing data");
+	graph.nthreads = nthreads;
+	if ((err = netini_load(&graph, argv, pattern, nthreads, &pool)) < 0)
+		die("msg=",netini_strerror(err), "path=",graph.failed.path,
+		  "line=",fmt(graph.failed.ln));
+
+	if (netini_net_tree(&graph) < 0)
+		die("msg=","sorting nets");
+	nnets = array_length(&graph.nets);
+	if ((span = mem_alloc(&pool, nnets * sizeof *span + 1)) == NULL)
+		die("msg=","indexing nets");
+	for (size_t pos = 0; pos < nnets; pos++)
+		span[graph.spans[pos].net] = pos;
+
+	ips = sort_ips(&graph, span, &nips, &pool);
+
+	i = 0;
+	for (size_t pos = 0; pos < nnets; pos++) {
+		size_t n = 0;
+
+		while (i + n < nips && ips[i + n].span == pos)
+			n++;
+		report_net(&graph, span, pos, ips + i, n);
+		i += n;
+	}
+
+	if (fflush(stdout) == EOF)
+		die("msg=","writing the report");
+	mem_free(&pool);
+	return 0;
+}
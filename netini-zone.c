@@ -0,0 +1,290 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compat.h"
+#include "conf.h"
+#include "ip.h"
+#include "log.h"
+#include "mem.h"
+#include "netini.h"
+
+/*
+ * Reverse DNS zones of the whole inventory: each net gives the reverse
+ * zone holding it, cut on the byte for IPv4 and on the nibble for IPv6
+ * where delegations can happen, and each host IP gets a PTR record in the
+ * smallest of these zones that holds it. The records are sorted once and
+ * written in one pass.
+ */
+
+#define ZONE_BUFSIZ (1 << 16)
+
+static char *arg0;
+static char const *domain;
+
+struct zone {
+	uint8_t beg[16], end[16];
+	int mask;
+	size_t parent; /* smallest zone holding this one, or NETINI_NONE */
+};
+
+struct record {
+	size_t zone;
+	uint8_t ip[16];
+	size_t host;
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-d domain] [-g pattern] [-j threads]"
+	  " [-o dir] [file...]\n", arg0);
+	exit(1);
+}
+
+static int
+zone_cmp(void const *v1, void const *v2)
+{
+	struct zone const *a = v1, *b = v2;
+	int i;
+
+	if ((i = memcmp(a->beg, b->beg, 16)) != 0)
+		return i;
+	return (a->mask > b->mask) - (a->mask < b->mask);
+}
+
+/*
+ * The zones of all nets, sorted by address with the larger first, without
+ * duplicates, and each linked to the smallest zone holding it. Zones never
+ * overlap partially, as they are all cut on a prefix.
+ */
+static struct zone *
+zone_list(struct netini_graph *graph, size_t *np, struct mem_pool *pool)
+{
+	struct zone *zones;
+	size_t *stack, depth = 0, n = array_length(&graph->nets), k = 0;
+
+	zones = mem_alloc(pool, n * sizeof *zones + 1);
+	stack = mem_alloc(pool, n * sizeof *stack + 1);
+	if (zones == NULL || stack == NULL)
+		die("msg=","listing zones");
+
+	for (size_t i = 0; i < n; i++) {
+		struct netini_net *net = array_i(&graph->nets, i);
+		struct zone *zone = &zones[i];
+
+		zone->mask = (ip_version(net->ip) == 4)
+		  ? 96 + (net->mask - 96) / 8 * 8 : net->mask / 4 * 4;
+		for (int b = 0; b < 16; b++) {
+			int bits = zone->mask - b * 8;
+			uint8_t mask = (bits >= 8) ? 0xff
+			  : (bits <= 0) ? 0x00 : 0xff ^ (0xff >> bits);
+
+			zone->beg[b] = net->ip[b] & mask;
+			zone->end[b] = net->ip[b] | (uint8_t)~mask;
+		}
+	}
+	qsort(zones, n, sizeof *zones, zone_cmp);
+
+	for (size_t i = 0; i < n; i++) {
+		if (k > 0 && zone_cmp(&zones[k - 1], &zones[i]) == 0)
+			continue;
+		zones[k] = zones[i];
+		while (depth > 0
+		 && memcmp(zones[stack[depth - 1]].end, zones[k].beg, 16) < 0)
+			depth--;
+		zones[k].parent = (depth > 0) ? stack[depth - 1] : NETINI_NONE;
+		stack[depth++] = k++;
+	}
+
+	mem_delete(stack);
+	*np = k;
+	return zones;
+}
+
+/*
+ * Smallest zone holding ip, or NETINI_NONE, as netini_find_net(), but of
+ * the same version: an IPv4 in ::/0 still has no name in ip6.arpa.
+ */
+static size_t
+zone_find(struct zone *zones, size_t n, uint8_t *ip)
+{
+	size_t beg = 0, end = n, z;
+	int version = ip_version(ip);
+
+	while (beg < end) {
+		size_t mid = beg + (end - beg) / 2;
+
+		if (memcmp(zones[mid].beg, ip, 16) <= 0)
+			beg = mid + 1;
+		else
+			end = mid;
+	}
+	if (beg == 0)
+		return NETINI_NONE;
+	for (z = beg - 1; z != NETINI_NONE; z = zones[z].parent)
+		if (memcmp(ip, zones[z].end, 16) <= 0
+		 && ip_version(zones[z].beg) == version)
+			break;
+	return z;
+}
+
+static int
+record_cmp(void const *v1, void const *v2)
+{
+	struct record const *a = v1, *b = v2;
+	int i;
+
+	if (a->zone != b->zone)
+		return (a->zone > b->zone) - (a->zone < b->zone);
+	if ((i = memcmp(a->ip, b->ip, 16)) != 0)
+		return i;
+	return (a->host > b->host) - (a->host < b->host);
+}
+
+static struct record *
+record_list(struct netini_graph *graph, struct zone *zones, size_t nzones,
+	size_t *np, struct mem_pool *pool)
+{
+	struct record *records;
+	size_t n = 0;
+
+	for (size_t i = 0; i < array_length(&graph->hosts); i++)
+		n += array_length(&((struct netini_host *)array_i(&graph->hosts, i))->ips);
+	if ((records = mem_alloc(pool, n * sizeof *records + 1)) == NULL)
+		die("msg=","listing records");
+
+	n = 0;
+	for (size_t i = 0; i < array_length(&graph->hosts); i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		for (size_t i2 = 0; i2 < array_length(&host->ips); i2++) {
+			uint8_t *ip = array_i(&host->ips, i2);
+			size_t zone = zone_find(zones, nzones, ip);
+
+			if (zone == NETINI_NONE) {
+				char buf[IP_FMT_ADDR_LEN];
+
+				ip_fmt_addr(buf, ip);
+				errno = 0;
+				warn("msg=","ip in no net, skipped", "ip=",buf,
+				  "host=",host->name);
+				continue;
+			}
+			records[n].zone = zone;
+			memcpy(records[n].ip, ip, 16);
+			records[n++].host = i;
+		}
+	}
+	qsort(records, n, sizeof *records, record_cmp);
+	*np = n;
+	return records;
+}
+
+static void
+write_zone(struct netini_graph *graph, struct zone *zone,
+	struct record *records, size_t n)
+{
+	char buf[IP_FMT_ARPA_LEN];
+
+	ip_fmt_arpa_zone(buf, zone->beg, zone->mask);
+	printf("$ORIGIN %s.\n", buf);
+
+	for (size_t i = 0; i < n; i++) {
+		struct netini_host *host = array_i(&graph->hosts, records[i].host);
+		size_t len = strlen(host->name);
+
+		ip_fmt_arpa_label(buf, records[i].ip, zone->mask);
+		fputs(buf, stdout);
+		fputs("\tPTR\t", stdout);
+		fputs(host->name, stdout);
+		if (len == 0 || host->name[len - 1] != '.') {
+			if (domain != NULL) {
+				putchar('.');
+				fputs(domain, stdout);
+			}
+			putchar('.');
+		}
+		putchar('\n');
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	static char buf[ZONE_BUFSIZ];
+	struct mem_pool pool = {0};
+	struct netini_graph graph = {0};
+	struct zone *zones;
+	struct record *records;
+	size_t nzones, nrecords, i;
+	char const *errstr;
+	char *pattern = "*.ini", *dir = NULL;
+	int c, err, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	arg0 = *argv;
+	while ((c = getopt(argc, argv, "d:g:j:o:")) != -1) {
+		switch (c) {
+		case 'd':
+			domain = optarg;
+			break;
+		case 'g':
+			pattern = optarg;
+			break;
+		case 'j':
+			nthreads = strtonum(optarg, 1, NETINI_THREADS_MAX, &errstr);
+			if (errstr != NULL)
+				usage();
+			break;
+		case 'o':
+			dir = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (netini_init_graph(&graph, &pool) < 0)
+		die("msg=","initializing data");
+	graph.nthreads = nthreads;
+	if ((err = netini_load(&graph, argv, pattern, nthreads, &pool)) < 0)
+		die("msg=",netini_strerror(err), "path=",graph.failed.path,
+		  "line=",fmt(graph.failed.ln));
+
+	zones = zone_list(&graph, &nzones, &pool);
+	records = record_list(&graph, zones, nzones, &nrecords, &pool);
+
+	setvbuf(stdout, buf, _IOFBF, sizeof buf);
+	i = 0;
+	for (size_t z = 0; z < nzones; z++) {
+		size_t n = 0;
+
+		while (i + n < nrecords && records[i + n].zone == z)
+			n++;
+		if (dir != NULL) {
+			char path[4096], name[IP_FMT_ARPA_LEN];
+
+			ip_fmt_arpa_zone(name, zones[z].beg, zones[z].mask);
+			snprintf(path, sizeof path, "%s/%s", dir, name);
+			if (freopen(path, "w", stdout) == NULL)
+				die("msg=","opening output", "path=",path);
+			setvbuf(stdout, buf, _IOFBF, sizeof buf);
+			write_zone(&graph, &zones[z], records + i, n);
+			if (fflush(stdout) == EOF)
+				die("msg=","writing output", "path=",path);
+		} else {
+			write_zone(&graph, &zones[z], records + i, n);
+		}
+		i += n;
+	}
+
+	if (fflush(stdout) == EOF)
+		die("msg=","writing output");
+	mem_free(&pool);
+	return 0;
+}
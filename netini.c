@@ -3,11 +3,16 @@
 #include <assert.h>
 #include <dirent.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "conf.h"
+#include "hash.h"
 #include "ip.h"
+#include "load.h"
 #include "mac.h"
 #include "mem.h"
 
@@ -188,11 +193,12 @@ netini_add_host(struct array *array, struct conf_section *section, size_t *ln)
 		return -NETINI_ERR_SYSTEM;
 
 	i = 0;
-	var = conf_next_variable(section, &i, "name");
+	if ((var = conf_next_variable(section, &i, "name")) == NULL) {
+		*ln = section->ln;
+		return -NETINI_ERR_MISSING_NAME_VARIABLE;
+	}
 	*ln = var->ln;
 	host.name = var->value;
-	if (host.name == NULL)
-		return -NETINI_ERR_MISSING_NAME_VARIABLE;
 
 	host.section = section;
 
@@ -249,43 +255,152 @@ netini_add_ipsec(struct array *ipsec, struct conf_section *section, size_t *ln)
 	return 0;
 }
 
-int
-netini_add_conf(struct netini_graph *graph, char *path, size_t *ln,
-	struct mem_pool *pool)
+static int
+netini_add_sections(struct netini_graph *graph, struct conf *conf, size_t *ln)
 {
-	struct conf conf = {0};
 	struct conf_section *section;
 	size_t i;
 	int err;
 
-	err = conf_parse_file(&conf, path, ln, pool);
-	if (err < 0)
-		return err;
+	graph->nfiles++;
+	graph->nbytes += conf->nbytes;
+	graph->nsections += array_length(&conf->sections);
+	graph->nvariables += conf->nvariables;
 
 	i = 0;
-	while ((section = conf_next_section(&conf, &i, "net"))) {
+	while ((section = conf_next_section(conf, &i, "net"))) {
+		if (conf_include_seen(&graph->included, section))
+			continue;
 		err = netini_add_net(&graph->nets, section, ln);
 		if (err < 0)
 			return err;
 	}
 
 	i = 0;
-	while ((section = conf_next_section(&conf, &i, "host"))) {
+	while ((section = conf_next_section(conf, &i, "host"))) {
+		if (conf_include_seen(&graph->included, section))
+			continue;
 		err = netini_add_host(&graph->hosts, section, ln);
 		if (err < 0)
 			return err;
 	}
 
 	i = 0;
-	while ((section = conf_next_section(&conf, &i, "ipsec"))) {
+	while ((section = conf_next_section(conf, &i, "ipsec"))) {
+		if (conf_include_seen(&graph->included, section))
+			continue;
 		err = netini_add_ipsec(&graph->ipsecs, section, ln);
 		if (err < 0)
 			return err;
 	}
 
+	/* the files included from another file already added are left out */
+	if (conf_include_mark(&graph->included, &conf->sections, 0,
+	  graph->included.pool) < 0)
+		return -NETINI_ERR_SYSTEM;
+	return 0;
+}
+
+int
+netini_add_conf(struct netini_graph *graph, char *path, size_t *ln,
+	struct mem_pool *pool)
+{
+	struct conf conf = {0};
+	int err;
+
+	err = conf_parse_file_parallel(&conf, path, graph->nthreads, ln, pool);
+	if (err < 0)
+		return err;
+	return netini_add_sections(graph, &conf, ln);
+}
+
+int
+netini_add_buffer(struct netini_graph *graph, char *buf, size_t len,
+	char const *path, size_t *ln, struct mem_pool *pool)
+{
+	struct conf conf = {0};
+	int err;
+
+	err = conf_parse_buffer(&conf, buf, len, path, ln, pool);
+	if (err < 0)
+		return err;
+	return netini_add_sections(graph, &conf, ln);
+}
+
+struct netini_loader {
+	struct netini_graph *graph;
+	struct mem_pool *pool;
+};
+
+static int
+netini_load_file(void *arg, char const *path, char *buf, size_t len)
+{
+	struct netini_loader *loader = arg;
+	struct netini_graph *graph = loader->graph;
+	struct netini_file file = {0};
+	int err;
+
+	file.path = path;
+	file.net = array_length(&graph->nets);
+	file.host = array_length(&graph->hosts);
+	graph->failed = file;
+	if (buf == NULL)
+		err = netini_add_conf(graph, (char *)path, &graph->failed.ln,
+		  loader->pool);
+	else
+		err = netini_add_buffer(graph, buf, len, path, &graph->failed.ln,
+		  loader->pool);
+	if (err < 0)
+		return err;
+	if (array_append(&graph->files, &file) < 0)
+		return -NETINI_ERR_SYSTEM;
 	return 0;
 }
 
+/*
+ * Add the files of argv, or the standard input if there are none, with
+ * the directories walked for the files matching pattern, and the files
+ * read ahead on nthreads threads. On error, graph->failed tells the file
+ * and the line where it happened.
+ */
+int
+netini_load(struct netini_graph *graph, char **argv, char const *pattern,
+	int nthreads, struct mem_pool *pool)
+{
+	struct netini_loader loader = { graph, pool };
+	struct array paths = {0};
+	size_t failed = 0;
+	int err = 0;
+
+	memset(&graph->failed, 0, sizeof graph->failed);
+	if (array_init(&paths, sizeof(char *), pool) < 0)
+		return -NETINI_ERR_SYSTEM;
+	if (*argv == NULL) {
+		graph->failed.path = "/dev/stdin";
+		if (load_expand("/dev/stdin", pattern, nthreads, &paths, pool) < 0)
+			err = -NETINI_ERR_SYSTEM;
+	}
+	for (; err == 0 && *argv != NULL; argv++) {
+		char *path = (strcmp(*argv, "-") == 0) ? "/dev/stdin" : *argv;
+
+		graph->failed.path = path;
+		if (load_expand(path, pattern, nthreads, &paths, pool) < 0)
+			err = -NETINI_ERR_SYSTEM;
+	}
+
+	if (err == 0) {
+		err = load_files(&paths, nthreads, netini_load_file, &loader,
+		  &failed);
+		/* a file that failed to be read was not parsed at all */
+		if (err < 0 && graph->failed.path != *(char **)array_i(&paths, failed)) {
+			memset(&graph->failed, 0, sizeof graph->failed);
+			graph->failed.path = *(char **)array_i(&paths, failed);
+		}
+	}
+	mem_delete(paths.mem);
+	return err;
+}
+
 int
 netini_init_graph(struct netini_graph *graph, struct mem_pool *pool)
 {
@@ -293,54 +408,715 @@ netini_init_graph(struct netini_graph *graph, struct mem_pool *pool)
 
         if (array_init(&graph->hosts, sizeof(struct netini_host), pool) < 0
          || array_init(&graph->nets, sizeof(struct netini_net), pool) < 0
-	 || array_init(&graph->ipsecs, sizeof(struct conf_section), pool) < 0)
+	 || array_init(&graph->ipsecs, sizeof(struct conf_section), pool) < 0
+	 || array_init(&graph->edges, sizeof(struct netini_edge), pool) < 0
+	 || array_init(&graph->files, sizeof(struct netini_file), pool) < 0
+	 || hash_init(&graph->included, 16, pool) < 0)
                 return -1;
 	graph->init = 1;
 	return 0;
 }
 
-struct netini_host *
-netini_next_linked(struct array *hosts, struct netini_link *link, size_t *i)
+static int
+netini_index_add(struct netini_index *index, struct hash *hash,
+	void const *key, size_t len, size_t host, size_t *n)
+{
+	void **slot;
+
+	if ((slot = hash_set(hash, key, len)) == NULL)
+		return -NETINI_ERR_SYSTEM;
+	/* the same value twice on a host */
+	if (*slot != NULL && index->host[(uintptr_t)*slot - 1] == host)
+		return 0;
+	index->host[*n] = host;
+	index->next[*n] = (uintptr_t)*slot;
+	*slot = (void *)(uintptr_t)++*n;
+	return 0;
+}
+
+/*
+ * Index every name, IP and MAC of the hosts once, with each key leading
+ * to a chain of the hosts having it. The hosts are added from the last,
+ * so that the chains follow the order of the hosts.
+ */
+int
+netini_index_links(struct netini_graph *graph)
+{
+	struct netini_index *index = &graph->links;
+	struct mem_pool *pool = graph->hosts.pool;
+	size_t nhosts = array_length(&graph->hosts), nips = 0, nmacs = 0, n = 0;
+	int err;
+
+	if (index->init)
+		return 0;
+
+	for (size_t i = 0; i < nhosts; i++) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		nips += array_length(&host->ips);
+		nmacs += array_length(&host->macs);
+	}
+	if (hash_init(&index->names, nhosts, pool) < 0
+	 || hash_init(&index->ips, nips, pool) < 0
+	 || hash_init(&index->macs, nmacs, pool) < 0)
+		return -NETINI_ERR_SYSTEM;
+	n = nhosts + nips + nmacs;
+	index->host = mem_alloc(pool, n * sizeof *index->host + 1);
+	index->next = mem_alloc(pool, n * sizeof *index->next + 1);
+	if (index->host == NULL || index->next == NULL)
+		return -NETINI_ERR_SYSTEM;
+
+	n = 0;
+	for (size_t i = nhosts; i-- > 0;) {
+		struct netini_host *host = array_i(&graph->hosts, i);
+
+		err = netini_index_add(index, &index->names, host->name,
+		  strlen(host->name), i, &n);
+		if (err < 0)
+			return err;
+		for (size_t i2 = array_length(&host->ips); i2-- > 0;)
+			if ((err = netini_index_add(index, &index->ips,
+			  array_i(&host->ips, i2), 16, i, &n)) < 0)
+				return err;
+		for (size_t i2 = array_length(&host->macs); i2-- > 0;)
+			if ((err = netini_index_add(index, &index->macs,
+			  array_i(&host->macs, i2), 6, i, &n)) < 0)
+				return err;
+	}
+	index->init = 1;
+	return 0;
+}
+
+/*
+ * Return the next host matching the link, or NETINI_NONE, starting with
+ * *it at 0, through the index of netini_index_links().
+ */
+size_t
+netini_next_linked(struct netini_graph *graph, struct netini_link *link,
+	size_t *it)
 {
-	for (; *i < array_length(hosts); (*i)++) {
-		struct netini_host *host = array_i(hosts, *i);
-		struct array *arr;
-		size_t sz;
+	struct netini_index *index = &graph->links;
+	uintptr_t u;
 
+	if (*it == 0) {
 		switch (link->type) {
 		case NETINI_T_IP:
-			arr = &host->ips;
-			for (size_t i2 = 0; i2 < array_length(arr); i2++) {
-				uint8_t *ip = array_i(arr, i2);
-
-				sz = sizeof link->u.ip;
-				if (memcmp(link->u.ip, ip, sz) == 0) {
-					return host;
-				}
-			}
+			u = (uintptr_t)hash_get(&index->ips, link->u.ip, 16);
 			break;
 		case NETINI_T_MAC:
-			arr = &host->macs;
-			for (size_t i2 = 0; i2 < array_length(arr); i2++) {
-				uint8_t *mac = array_i(arr, i2);
-
-				sz = sizeof link->u.mac;
-				if (memcmp(link->u.mac, mac, sz) == 0) {
-					(*i)++;
-					return host;
-				}
-			}
+			u = (uintptr_t)hash_get(&index->macs, link->u.mac, 6);
 			break;
 		case NETINI_T_NAME:
-			assert(host->name != NULL);
-			assert(link->u.name != NULL);
-
-			if (strcmp(link->u.name, host->name) == 0) {
-				(*i)++;
-				return host;
-			}
+			u = (uintptr_t)hash_get(&index->names, link->u.name,
+			  strlen(link->u.name));
 			break;
+		default:
+			u = 0;
 		}
+	} else {
+		u = index->next[*it - 1];
 	}
+	*it = u;
+	return (u == 0) ? NETINI_NONE : index->host[u - 1];
+}
+
+size_t
+netini_node_count(struct netini_graph *graph)
+{
+	return array_length(&graph->nets) + array_length(&graph->hosts);
+}
+
+char const *
+netini_node_name(struct netini_graph *graph, size_t node)
+{
+	size_t nnets = array_length(&graph->nets);
+
+	if (node < nnets)
+		return ((struct netini_net *)array_i(&graph->nets, node))->name;
+	return ((struct netini_host *)array_i(&graph->hosts, node - nnets))->name;
+}
+
+/*
+ * Index all node names once the graph is loaded, keeping the first node of
+ * each name as the one links resolve to. The values are node numbers + 1,
+ * to tell them apart from the NULL of new entries.
+ */
+static int
+netini_index_names(struct netini_graph *graph)
+{
+	size_t n = netini_node_count(graph);
+
+	if (graph->names.init)
+		return 0;
+	if (hash_init(&graph->names, n, graph->hosts.pool) < 0)
+		return -NETINI_ERR_SYSTEM;
+
+	for (size_t node = 0; node < n; node++) {
+		char const *name = netini_node_name(graph, node);
+		void **value;
+
+		value = hash_set(&graph->names, name, strlen(name));
+		if (value == NULL)
+			return -NETINI_ERR_SYSTEM;
+		if (*value == NULL)
+			*value = (void *)(uintptr_t)(node + 1);
+	}
+	return 0;
+}
+
+size_t
+netini_find_node(struct netini_graph *graph, char const *name)
+{
+	uintptr_t u;
+
+	if (netini_index_names(graph) < 0)
+		return NETINI_NONE;
+	u = (uintptr_t)hash_get(&graph->names, name, strlen(name));
+	return (u == 0) ? NETINI_NONE : u - 1;
+}
+
+static int
+netini_add_edge(struct array *edges, enum netini_edge_type type,
+	size_t node1, size_t node2, char const *name1, char const *name2)
+{
+	struct netini_edge edge;
+
+	edge.type = type;
+	edge.node[0] = node1;
+	edge.node[1] = node2;
+	edge.name[0] = name1;
+	edge.name[1] = name2;
+	if (array_append(edges, &edge) < 0)
+		return -NETINI_ERR_SYSTEM;
+	return 0;
+}
+
+/*
+ * The edge passes are split among graph->nthreads threads, each with a
+ * contiguous range of items, and its own pool and edges array for not
+ * sharing anything but the graph they read. The edges are concatenated
+ * in the order of the ranges, to be the same as with one thread.
+ */
+struct netini_job {
+	struct netini_graph *graph;
+	int (*fn)(struct netini_job *job, size_t i);
+	size_t beg, end;
+	struct mem_pool pool;
+	struct array edges; /* struct netini_edge */
+	size_t nprobes;
+	int err;
+};
+
+static void *
+netini_job(void *v)
+{
+	struct netini_job *job = v;
+
+	for (size_t i = job->beg; i < job->end; i++)
+		if ((job->err = job->fn(job, i)) < 0)
+			break;
 	return NULL;
 }
+
+static int
+netini_run_jobs(struct netini_graph *graph, size_t n,
+	int (*fn)(struct netini_job *job, size_t i))
+{
+	struct netini_job jobs[NETINI_THREADS_MAX] = {{0}};
+	pthread_t threads[NETINI_THREADS_MAX];
+	int started[NETINI_THREADS_MAX];
+	int nthreads = graph->nthreads, err = 0;
+
+	if (nthreads > NETINI_THREADS_MAX)
+		nthreads = NETINI_THREADS_MAX;
+	if ((size_t)nthreads > n)
+		nthreads = n;
+	if (nthreads < 1)
+		nthreads = 1;
+
+	for (int t = 0; t < nthreads; t++) {
+		jobs[t].graph = graph;
+		jobs[t].fn = fn;
+		jobs[t].beg = n * t / nthreads;
+		jobs[t].end = n * (t + 1) / nthreads;
+		if (array_init(&jobs[t].edges, sizeof(struct netini_edge),
+		  &jobs[t].pool) < 0)
+			jobs[t].end = jobs[t].beg, err = -NETINI_ERR_SYSTEM;
+	}
+
+	/* the jobs of threads that fail to start are run here */
+	for (int t = 1; t < nthreads; t++)
+		started[t] = (pthread_create(&threads[t], NULL,
+		  netini_job, &jobs[t]) == 0);
+	netini_job(&jobs[0]);
+	for (int t = 1; t < nthreads; t++) {
+		if (started[t])
+			pthread_join(threads[t], NULL);
+		else
+			netini_job(&jobs[t]);
+	}
+
+	for (int t = 0; t < nthreads; t++) {
+		if (jobs[t].err < 0)
+			err = jobs[t].err;
+		if (err == 0 && array_concat(&graph->edges, &jobs[t].edges) < 0)
+			err = -NETINI_ERR_SYSTEM;
+		graph->nprobes += jobs[t].nprobes;
+		mem_free(&jobs[t].pool);
+	}
+	return err;
+}
+
+static int
+netini_span_cmp(void const *v1, void const *v2)
+{
+	struct netini_span const *a = v1, *b = v2;
+	int i;
+
+	if ((i = memcmp(a->beg, b->beg, sizeof a->beg)) != 0)
+		return i;
+	if ((i = memcmp(b->end, a->end, sizeof a->end)) != 0)
+		return i;
+	return (a->net > b->net) - (a->net < b->net);
+}
+
+/*
+ * Sort the nets by their range of addresses, and link each to the
+ * smallest net holding it. As nets are either inside one another or
+ * apart, the parent of a net is the last one before it in that order
+ * whose range is still open, which a stack of open ranges keeps track of.
+ */
+int
+netini_net_tree(struct netini_graph *graph)
+{
+	struct netini_span *spans;
+	size_t *stack, depth = 0, n = array_length(&graph->nets);
+
+	if (graph->spans != NULL)
+		return 0;
+
+	spans = mem_alloc(graph->hosts.pool, n * sizeof *spans + 1);
+	if (spans == NULL)
+		return -NETINI_ERR_SYSTEM;
+	stack = mem_alloc(graph->hosts.pool, n * sizeof *stack + 1);
+	if (stack == NULL) {
+		mem_delete(spans);
+		return -NETINI_ERR_SYSTEM;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		struct netini_net *net = array_i(&graph->nets, i);
+
+		for (int b = 0; b < 16; b++) {
+			int bits = net->mask - b * 8;
+			uint8_t mask = (bits >= 8) ? 0xff
+			  : (bits <= 0) ? 0x00 : 0xff ^ (0xff >> bits);
+
+			spans[i].beg[b] = net->ip[b] & mask;
+			spans[i].end[b] = net->ip[b] | (uint8_t)~mask;
+		}
+		spans[i].net = i;
+		net->parent = net->child = net->next = NETINI_NONE;
+	}
+	qsort(spans, n, sizeof *spans, netini_span_cmp);
+
+	for (size_t i = 0; i < n; i++) {
+		struct netini_net *net = array_i(&graph->nets, spans[i].net);
+
+		while (depth > 0
+		 && memcmp(spans[stack[depth - 1]].end, spans[i].beg, 16) < 0)
+			depth--;
+		if (depth > 0)
+			net->parent = spans[stack[depth - 1]].net;
+		stack[depth++] = i;
+	}
+
+	/* backward, for the children to be in the order of their address */
+	for (size_t i = n; i > 0; i--) {
+		struct netini_net *net = array_i(&graph->nets, spans[i - 1].net);
+		struct netini_net *parent;
+
+		if (net->parent == NETINI_NONE)
+			continue;
+		parent = array_i(&graph->nets, net->parent);
+		net->next = parent->child;
+		parent->child = spans[i - 1].net;
+	}
+
+	mem_delete(stack);
+	graph->spans = spans;
+	return 0;
+}
+
+/*
+ * Return the smallest net holding ip, or NETINI_NONE. The last net
+ * starting at or before ip is inside that net if it does not hold ip
+ * itself, so that the net is among its parents.
+ */
+size_t
+netini_find_net(struct netini_graph *graph, uint8_t *ip)
+{
+	size_t beg = 0, end = array_length(&graph->nets), net;
+
+	assert(graph->spans != NULL);
+
+	while (beg < end) {
+		size_t mid = beg + (end - beg) / 2;
+
+		if (memcmp(graph->spans[mid].beg, ip, 16) <= 0)
+			beg = mid + 1;
+		else
+			end = mid;
+	}
+	if (beg == 0)
+		return NETINI_NONE;
+
+	for (net = graph->spans[beg - 1].net; net != NETINI_NONE;) {
+		struct netini_net *p = array_i(&graph->nets, net);
+
+		if (ip_match(ip, p->ip, p->mask))
+			break;
+		net = p->parent;
+	}
+	return net;
+}
+
+/*
+ * Each IP of the host is looked up in the tree of nets, and linked to the
+ * smallest net holding it, and unless graph->nested, to all its parents.
+ */
+static int
+netini_l3_job(struct netini_job *job, size_t i1)
+{
+	struct netini_graph *graph = job->graph;
+	struct netini_host *host = array_i(&graph->hosts, i1);
+	size_t nnets = array_length(&graph->nets);
+
+	for (size_t i2 = 0; i2 < array_length(&host->ips); i2++) {
+		size_t i3 = netini_find_net(graph, array_i(&host->ips, i2));
+
+		while (i3 != NETINI_NONE) {
+			struct netini_net *net = array_i(&graph->nets, i3);
+
+			if (netini_add_edge(&job->edges, NETINI_E_L3, i3,
+			  nnets + i1, net->name, host->name) < 0)
+				return -NETINI_ERR_SYSTEM;
+			job->nprobes++;
+			i3 = graph->nested ? NETINI_NONE : net->parent;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Stable counting sort of the edges from beg on by their net, for them to
+ * come in the order of the nets like in a pass over every net.
+ */
+static int
+netini_sort_l3_edges(struct netini_graph *graph, size_t beg)
+{
+	struct mem_pool *pool = graph->hosts.pool;
+	size_t nnets = array_length(&graph->nets);
+	size_t n = array_length(&graph->edges) - beg;
+	struct netini_edge *edges, *copy;
+	size_t *count;
+
+	if (n == 0)
+		return 0;
+	edges = array_i(&graph->edges, beg);
+	if ((count = mem_alloc(pool, (nnets + 1) * sizeof *count)) == NULL)
+		return -NETINI_ERR_SYSTEM;
+	if ((copy = mem_alloc(pool, n * sizeof *copy)) == NULL) {
+		mem_delete(count);
+		return -NETINI_ERR_SYSTEM;
+	}
+	memcpy(copy, edges, n * sizeof *copy);
+
+	for (size_t i = 0; i < n; i++)
+		count[copy[i].node[0] + 1]++;
+	for (size_t i = 1; i <= nnets; i++)
+		count[i] += count[i - 1];
+	for (size_t i = 0; i < n; i++)
+		edges[count[copy[i].node[0]]++] = copy[i];
+
+	mem_delete(count);
+	mem_delete(copy);
+	return 0;
+}
+
+int
+netini_add_l3_edges(struct netini_graph *graph)
+{
+	size_t beg = array_length(&graph->edges);
+	int err;
+
+	/* built before the threads, which then only read it */
+	if (netini_net_tree(graph) < 0)
+		return -NETINI_ERR_SYSTEM;
+	err = netini_run_jobs(graph, array_length(&graph->hosts), netini_l3_job);
+	if (err < 0)
+		return err;
+	if ((err = netini_sort_l3_edges(graph, beg)) < 0)
+		return err;
+
+	if (!graph->nested)
+		return 0;
+	for (size_t i = 0; i < array_length(&graph->nets); i++) {
+		struct netini_net *net = array_i(&graph->nets, i), *parent;
+
+		if (net->parent == NETINI_NONE)
+			continue;
+		parent = array_i(&graph->nets, net->parent);
+		if (netini_add_edge(&graph->edges, NETINI_E_NET, net->parent, i,
+		  parent->name, net->name) < 0)
+			return -NETINI_ERR_SYSTEM;
+	}
+	return 0;
+}
+
+static int
+netini_l2_job(struct netini_job *job, size_t i1)
+{
+	struct netini_graph *graph = job->graph;
+	struct netini_host *this = array_i(&graph->hosts, i1);
+	size_t nnets = array_length(&graph->nets);
+
+	for (size_t i2 = 0; i2 < array_length(&this->links); i2++) {
+		struct netini_link *link = array_i(&this->links, i2);
+		size_t it = 0, i3;
+
+		while ((i3 = netini_next_linked(graph, link, &it)) != NETINI_NONE) {
+			struct netini_host *other = array_i(&graph->hosts, i3);
+
+			if (netini_add_edge(&job->edges, NETINI_E_L2, nnets + i1,
+			  nnets + i3, this->name, other->name) < 0)
+				return -NETINI_ERR_SYSTEM;
+			job->nprobes++;
+		}
+	}
+	return 0;
+}
+
+int
+netini_add_l2_edges(struct netini_graph *graph)
+{
+	int err;
+
+	/* built before the threads, which then only read it */
+	if ((err = netini_index_links(graph)) < 0)
+		return err;
+	return netini_run_jobs(graph, array_length(&graph->hosts), netini_l2_job);
+}
+
+static int
+netini_ipsec_job(struct netini_job *job, size_t i1)
+{
+	struct netini_graph *graph = job->graph;
+	struct conf_section *section = array_i(&graph->ipsecs, i1);
+	char *h1;
+	size_t i2 = 0;
+
+	while ((h1 = conf_next_value(section, &i2, "host"))) {
+		char *h2;
+		size_t i3 = i2;
+
+		while ((h2 = conf_next_value(section, &i3, "host"))) {
+			if (strcmp(h1, h2) == 0)
+				continue;
+			if (netini_add_edge(&job->edges, NETINI_E_IPSEC,
+			  netini_find_node(graph, h1),
+			  netini_find_node(graph, h2), h1, h2) < 0)
+				return -NETINI_ERR_SYSTEM;
+		}
+	}
+	return 0;
+}
+
+int
+netini_add_ipsec_edges(struct netini_graph *graph)
+{
+	/* built before the threads, which then only read it */
+	if (netini_index_names(graph) < 0)
+		return -NETINI_ERR_SYSTEM;
+	return netini_run_jobs(graph, array_length(&graph->ipsecs),
+	  netini_ipsec_job);
+}
+
+/*
+ * Pack the edges into adjacency lists stored one after the other in adj:
+ * the neighbours of node are adj[first[node]] to adj[first[node + 1] - 1].
+ * Edges toward unknown nodes are left out.
+ */
+int
+netini_adjacency(struct netini_graph *graph, size_t **firstp, size_t **adjp)
+{
+	struct mem_pool *pool = graph->hosts.pool;
+	size_t n = netini_node_count(graph);
+	size_t nedges = array_length(&graph->edges);
+	size_t *first, *adj;
+
+	first = mem_alloc(pool, (n + 1) * sizeof *first);
+	if (first == NULL)
+		return -NETINI_ERR_SYSTEM;
+	adj = mem_alloc(pool, nedges * 2 * sizeof *adj + 1);
+	if (adj == NULL) {
+		mem_delete(first);
+		return -NETINI_ERR_SYSTEM;
+	}
+
+	for (size_t i = 0; i < nedges; i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+
+		if (edge->node[0] == NETINI_NONE || edge->node[1] == NETINI_NONE)
+			continue;
+		first[edge->node[0] + 1]++;
+		first[edge->node[1] + 1]++;
+	}
+	for (size_t i = 0; i < n; i++)
+		first[i + 1] += first[i];
+	for (size_t i = 0; i < nedges; i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+
+		if (edge->node[0] == NETINI_NONE || edge->node[1] == NETINI_NONE)
+			continue;
+		adj[first[edge->node[0]]++] = edge->node[1];
+		adj[first[edge->node[1]]++] = edge->node[0];
+	}
+	/* filling moved each offset to the start of the next list */
+	for (size_t i = n; i > 0; i--)
+		first[i] = first[i - 1];
+	first[0] = 0;
+
+	*firstp = first;
+	*adjp = adj;
+	return 0;
+}
+
+/*
+ * Set primary[node] to the net in which a host has its first IP, among the
+ * nets with shown[net] set, and to NETINI_NONE for the nets and the hosts
+ * in no net. The nodes are all shown if shown is NULL.
+ */
+void
+netini_primary_nets(struct netini_graph *graph, uint8_t const *shown,
+	size_t *primary)
+{
+	size_t n = netini_node_count(graph);
+
+	for (size_t i = 0; i < n; i++)
+		primary[i] = NETINI_NONE;
+	for (size_t i = 0; i < array_length(&graph->edges); i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+
+		if (edge->type != NETINI_E_L3
+		 || primary[edge->node[1]] != NETINI_NONE
+		 || (shown != NULL && !shown[edge->node[0]]))
+			continue;
+		primary[edge->node[1]] = edge->node[0];
+	}
+}
+
+/*
+ * Breadth-first search from the seed nodes over all the edges, setting
+ * reached[node] to 1 for every node at most radius edges away.
+ */
+int
+netini_reach(struct netini_graph *graph, size_t *seeds, size_t nseeds,
+	size_t radius, uint8_t *reached)
+{
+	size_t n = netini_node_count(graph);
+	size_t *first, *adj, *queue, beg, end, depth;
+
+	queue = mem_alloc(graph->hosts.pool, n * sizeof *queue + 1);
+	if (queue == NULL)
+		return -NETINI_ERR_SYSTEM;
+	if (netini_adjacency(graph, &first, &adj) < 0) {
+		mem_delete(queue);
+		return -NETINI_ERR_SYSTEM;
+	}
+
+	memset(reached, 0, n);
+	end = 0;
+	for (size_t i = 0; i < nseeds; i++) {
+		assert(seeds[i] < n);
+		if (!reached[seeds[i]]) {
+			reached[seeds[i]] = 1;
+			queue[end++] = seeds[i];
+		}
+	}
+
+	/* the queue holds one depth level after the other */
+	for (beg = 0, depth = 0; beg < end && depth < radius; depth++) {
+		size_t level_end = end;
+
+		for (; beg < level_end; beg++) {
+			size_t node = queue[beg];
+
+			for (size_t i = first[node]; i < first[node + 1]; i++) {
+				if (reached[adj[i]])
+					continue;
+				reached[adj[i]] = 1;
+				queue[end++] = adj[i];
+			}
+		}
+	}
+
+	mem_delete(first);
+	mem_delete(adj);
+	mem_delete(queue);
+	return 0;
+}
+
+static size_t
+netini_find_root(size_t *parent, size_t node)
+{
+	/* path halving: every other node points to its grandparent */
+	while (parent[node] != node) {
+		parent[node] = parent[parent[node]];
+		node = parent[node];
+	}
+	return node;
+}
+
+/*
+ * Number the connected components over all the edges with a union-find:
+ * component[node] is set from 0 upward, in the order of the first node of
+ * each component. Return the number of components, or a negative error.
+ */
+ssize_t
+netini_components(struct netini_graph *graph, size_t *component)
+{
+	size_t n = netini_node_count(graph);
+	size_t *parent, ncomponents = 0;
+
+	parent = mem_alloc(graph->hosts.pool, n * sizeof *parent + 1);
+	if (parent == NULL)
+		return -NETINI_ERR_SYSTEM;
+
+	for (size_t i = 0; i < n; i++)
+		parent[i] = i;
+	for (size_t i = 0; i < array_length(&graph->edges); i++) {
+		struct netini_edge *edge = array_i(&graph->edges, i);
+		size_t a, b;
+
+		if (edge->node[0] == NETINI_NONE || edge->node[1] == NETINI_NONE)
+			continue;
+		a = netini_find_root(parent, edge->node[0]);
+		b = netini_find_root(parent, edge->node[1]);
+
+		/* the root is always the lowest node of the component */
+		if (a < b)
+			parent[b] = a;
+		else if (b < a)
+			parent[a] = b;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		size_t root = netini_find_root(parent, i);
+
+		component[i] = (root == i) ? ncomponents++ : component[root];
+	}
+
+	mem_delete(parent);
+	return ncomponents;
+}
@@ -2,8 +2,10 @@
 #define NETINI_H
 
 #include <stdint.h>
+#include <sys/types.h>
 
 #include "conf.h"
+#include "hash.h"
 
 enum netini_errno {
 	NETINI_ERR_SYSTEM = CONF_ERR_ENUM_END,
@@ -21,6 +23,15 @@ struct netini_net {
 	uint8_t ip[16];
 	int mask;
 	struct conf_section *section;
+	size_t parent; /* smallest net holding this one, or NETINI_NONE */
+	size_t child; /* first net right inside this one, or NETINI_NONE */
+	size_t next; /* next net with the same parent, or NETINI_NONE */
+};
+
+/* range of addresses of a net, from the first to the last one */
+struct netini_span {
+	uint8_t beg[16], end[16];
+	size_t net;
 };
 
 struct netini_host {
@@ -31,11 +42,57 @@ struct netini_host {
 	struct conf_section *section;
 };
 
+/* hosts by name, IP and MAC, for resolving the links */
+struct netini_index {
+	int init;
+	struct hash names, ips, macs; /* key -> first entry + 1 */
+	size_t *host; /* host of each entry */
+	size_t *next; /* next entry + 1 with the same key, in host order */
+};
+
+/* file added by netini_load(), and where its nets and hosts begin */
+struct netini_file {
+	char const *path;
+	size_t net, host;
+	size_t ln; /* line of the error, in graph->failed */
+};
+
 struct netini_graph {
 	int init;
 	struct array nets; /* struct netini_host */
 	struct array hosts; /* struct netini_host */
 	struct array ipsecs; /* struct conf_section */
+	struct array edges; /* struct netini_edge */
+	struct hash names; /* char *name -> struct netini_host or netini_net */
+	struct hash included; /* struct conf_key of the files included, once */
+	struct array files; /* struct netini_file, in the order read */
+	struct netini_file failed; /* where netini_load() stopped on error */
+	struct netini_index links; /* filled for the L2 edges */
+	struct netini_span *spans; /* nets by first address, larger first */
+	int nested; /* hosts only in their smallest net, nets in their parent */
+	size_t nfiles, nbytes, nsections, nvariables, nprobes;
+	int nthreads; /* used for computing the edges, 1 if 0 */
+};
+
+#define NETINI_THREADS_MAX 64
+
+/*
+ * Nodes are numbered with the nets first, then the hosts, in the order of
+ * their arrays.
+ */
+#define NETINI_NONE ((size_t)-1)
+
+enum netini_edge_type {
+	NETINI_E_L3, /* host with an IP inside a net */
+	NETINI_E_L2, /* link= entry of a host */
+	NETINI_E_IPSEC, /* pair of hosts of an [ipsec] section */
+	NETINI_E_NET, /* net inside a larger one, the larger first */
+};
+
+struct netini_edge {
+	enum netini_edge_type type;
+	size_t node[2]; /* NETINI_NONE for unknown ipsec hosts */
+	char const *name[2];
 };
 
 enum netini_type {
@@ -56,7 +113,22 @@ struct netini_link {
 /** src/netini.c **/
 char const * netini_strerror(int i);
 int netini_add_conf(struct netini_graph *graph, char *path, size_t *ln, struct mem_pool *pool);
+int netini_add_buffer(struct netini_graph *graph, char *buf, size_t len, char const *path, size_t *ln, struct mem_pool *pool);
+int netini_load(struct netini_graph *graph, char **argv, char const *pattern, int nthreads, struct mem_pool *pool);
 int netini_init_graph(struct netini_graph *graph, struct mem_pool *pool);
-struct netini_host * netini_next_linked(struct array *hosts, struct netini_link *link, size_t *i);
+int netini_index_links(struct netini_graph *graph);
+size_t netini_next_linked(struct netini_graph *graph, struct netini_link *link, size_t *it);
+size_t netini_node_count(struct netini_graph *graph);
+char const * netini_node_name(struct netini_graph *graph, size_t node);
+size_t netini_find_node(struct netini_graph *graph, char const *name);
+int netini_net_tree(struct netini_graph *graph);
+size_t netini_find_net(struct netini_graph *graph, uint8_t *ip);
+int netini_add_l3_edges(struct netini_graph *graph);
+int netini_add_l2_edges(struct netini_graph *graph);
+int netini_add_ipsec_edges(struct netini_graph *graph);
+int netini_adjacency(struct netini_graph *graph, size_t **firstp, size_t **adjp);
+void netini_primary_nets(struct netini_graph *graph, uint8_t const *shown, size_t *primary);
+int netini_reach(struct netini_graph *graph, size_t *seeds, size_t nseeds, size_t radius, uint8_t *reached);
+ssize_t netini_components(struct netini_graph *graph, size_t *component);
 
 #endif
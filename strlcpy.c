@@ -8,8 +8,10 @@ strlcpy(char *buf, char const *str, size_t sz)
 	size_t len, cpy;
 
 	len = strlen(str);
-	cpy = (len > sz) ? (sz) : (len);
-	memcpy(buf, str, cpy + 1);
-	buf[sz - 1] = '\0';
+	if (sz == 0)
+		return len;
+	cpy = (len >= sz) ? (sz - 1) : (len);
+	memcpy(buf, str, cpy);
+	buf[cpy] = '\0';
 	return len;
 }
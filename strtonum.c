@@ -0,0 +1,32 @@
+#include "compat.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+
+long long
+strtonum(char const *s, long long min, long long max, char const **errstr)
+{
+	long long ll;
+	char *end;
+
+	errno = 0;
+	ll = strtoll(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || min > max) {
+		errno = EINVAL;
+		*errstr = "invalid";
+		return 0;
+	}
+	if ((ll == LLONG_MIN && errno == ERANGE) || ll < min) {
+		errno = ERANGE;
+		*errstr = "too small";
+		return 0;
+	}
+	if ((ll == LLONG_MAX && errno == ERANGE) || ll > max) {
+		errno = ERANGE;
+		*errstr = "too large";
+		return 0;
+	}
+	*errstr = NULL;
+	return ll;
+}
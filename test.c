@@ -0,0 +1,793 @@
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "array.h"
+#include "conf.h"
+#include "hash.h"
+#include "ip.h"
+#include "load.h"
+#include "log.h"
+#include "mac.h"
+#include "mem.h"
+#include "netini.h"
+#include "test.h"
+
+/*
+ * Compare ip_parse_addr() against the libc inet_pton(), which is the
+ * reference for what an address is.
+ */
+static int
+ip_parse_same_as_inet_pton(char const *s)
+{
+	uint8_t ip[16], ref[16] = {0};
+	char const *cp;
+	int ok;
+
+	if (inet_pton(AF_INET6, s, ref) == 1) {
+		ok = 1;
+	} else if (inet_pton(AF_INET, s, ref + 12) == 1) {
+		memset(ref + 10, 0xff, 2);
+		ok = 1;
+	} else {
+		ok = 0;
+	}
+
+	cp = ip_parse_addr(s, ip);
+	if (cp == NULL || *cp != '\0')
+		return !ok;
+	return ok && memcmp(ip, ref, 16) == 0;
+}
+
+/*
+ * Parse s, expected in the form inet_ntop() gives, and check that
+ * ip_fmt_addr() formats it back the same.
+ */
+static int
+ip_fmt_same_as_inet_ntop(char const *s)
+{
+	uint8_t ip[16];
+	char buf[IP_FMT_ADDR_LEN];
+
+	if (ip_parse_addr(s, ip) == NULL)
+		return 0;
+	ip_fmt_addr(buf, ip);
+	return strcmp(buf, s) == 0;
+}
+
+static char const *ip_samples[] = {
+	"0.0.0.0", "1.2.3.4", "255.255.255.255", "10.191.10.130",
+	"256.1.1.1", "1.2.3", "1.2.3.4.5", "1..2.3", "01.2.3.4", "1.2.3.04",
+	"1.2.3.4 ", " 1.2.3.4", "1.2.3.-4", "+1.2.3.4", "1.2.3.4/24",
+	"::", "::1", "1::", "1::2", "::ffff:1.2.3.4", "::1.2.3.4",
+	"1:2:3:4:5:6:7:8", "1:2:3:4:5:6:7::", "::2:3:4:5:6:7:8",
+	"1:2:3:4:5:6:1.2.3.4", "1:2:3:4:5::1.2.3.4", "1:2:3:4:5:6:7:1.2.3.4",
+	"fe80::1ff:fe23:4567:890a", "2001:DB8::A", "2001:db8:0:0:0:0:2:1",
+	":", ":::", "1:::2", "1::2::3", ":1", "1:", "1:2:3:4:5:6:7:8:",
+	"1:2:3:4:5:6:7:8:9", "::1:2:3:4:5:6:7:8", "12345::", "0x1::",
+	"g::", "1.2.3.4::", "::1.2.3", "::256.1.1.1", "", "-", "a",
+	NULL
+};
+
+static void
+test_ip(void)
+{
+	uint8_t ip[16];
+	int mask, ok;
+
+	test_lib("ip.c");
+
+	test_fn("ip_parse_addr");
+	for (char const **s = ip_samples; *s != NULL; s++)
+		test(ip_parse_same_as_inet_pton(*s));
+
+	test_fn("ip_parse_addr (random)");
+	srand(0);
+	ok = 1;
+	for (int n = 0; n < 10000; n++) {
+		char buf[INET6_ADDRSTRLEN];
+		uint8_t ref[16];
+
+		/* runs of zeroes so that inet_ntop uses "::" */
+		for (int i = 0; i < 16; i++)
+			ref[i] = (rand() % 3 == 0) ? 0 : rand() & 0xff;
+		inet_ntop(AF_INET6, ref, buf, sizeof buf);
+		ok = ok && ip_parse_same_as_inet_pton(buf);
+
+		inet_ntop(AF_INET, ref, buf, sizeof buf);
+		ok = ok && ip_parse_same_as_inet_pton(buf);
+	}
+	test(ok);
+
+	test_fn("ip_fmt_addr");
+	test(ip_fmt_same_as_inet_ntop("::"));
+	test(ip_fmt_same_as_inet_ntop("::1"));
+	test(ip_fmt_same_as_inet_ntop("1::"));
+	test(ip_fmt_same_as_inet_ntop("2001:db8::2:1"));
+	test(ip_fmt_same_as_inet_ntop("2001:db8:0:1:1:1:1:1"));
+	test(ip_fmt_same_as_inet_ntop("2001:0:0:1::1"));
+	test(ip_fmt_same_as_inet_ntop("1:0:0:2::3"));
+	test(ip_fmt_same_as_inet_ntop("fe80::1ff:fe23:4567:890a"));
+	test(ip_fmt_same_as_inet_ntop("10.191.10.130"));
+	test(ip_fmt_same_as_inet_ntop("0.0.0.0"));
+
+	test_fn("ip_fmt_addr (random)");
+	ok = 1;
+	for (int n = 0; n < 10000; n++) {
+		char buf[INET6_ADDRSTRLEN];
+		uint8_t ref[16];
+
+		for (int i = 0; i < 16; i++)
+			ref[i] = (rand() % 3 == 0) ? 0 : rand() & 0xff;
+		/* inet_ntop() has its own forms for the IPv4-compatible ones */
+		ref[0] |= 0x20;
+		inet_ntop(AF_INET6, ref, buf, sizeof buf);
+		ok = ok && ip_fmt_same_as_inet_ntop(buf);
+
+		inet_ntop(AF_INET, ref, buf, sizeof buf);
+		ok = ok && ip_fmt_same_as_inet_ntop(buf);
+	}
+	test(ok);
+
+	test_fn("ip_parse_mask");
+	test(ip_parse_mask("/24", 4, &mask) != NULL && mask == 96 + 24);
+	test(ip_parse_mask("/0", 4, &mask) != NULL && mask == 96);
+	test(ip_parse_mask("/32", 4, &mask) != NULL && mask == 128);
+	test(ip_parse_mask("/33", 4, &mask) == NULL);
+	test(ip_parse_mask("/128", 6, &mask) != NULL && mask == 128);
+	test(ip_parse_mask("/129", 6, &mask) == NULL);
+	test(ip_parse_mask("24", 4, &mask) == NULL);
+	test(ip_parse_mask("/", 4, &mask) == NULL);
+	test(ip_parse_mask("/-1", 6, &mask) == NULL);
+
+	test_fn("ip_match");
+	ip_parse_addr("10.191.10.0", ip);
+	{
+		uint8_t other[16];
+
+		ip_parse_addr("10.191.11.255", other);
+		test(ip_match(ip, other, 96 + 23));
+		test(!ip_match(ip, other, 96 + 24));
+		test(!ip_match(ip, other, 128));
+		test(ip_match(ip, ip, 128));
+		test(ip_match(ip, other, 0));
+	}
+
+	test_fn("ip_fmt_arpa");
+	{
+		char buf[IP_FMT_ARPA_LEN];
+
+		ip_parse_addr("10.191.10.2", ip);
+		ip_fmt_arpa(buf, ip);
+		test(strcmp(buf, "2.10.191.10.in-addr.arpa") == 0);
+		ip_fmt_arpa_zone(buf, ip, 96 + 24);
+		test(strcmp(buf, "10.191.10.in-addr.arpa") == 0);
+		ip_fmt_arpa_label(buf, ip, 96 + 16);
+		test(strcmp(buf, "2.10") == 0);
+		ip_fmt_arpa_label(buf, ip, 128);
+		test(strcmp(buf, "@") == 0);
+
+		ip_parse_addr("2001:db8::567:89ab", ip);
+		ip_fmt_arpa(buf, ip);
+		test(strcmp(buf, "b.a.9.8.7.6.5.0.0.0.0.0.0.0.0.0"
+		  ".0.0.0.0.0.0.0.0.8.b.d.0.1.0.0.2.ip6.arpa") == 0);
+		ip_fmt_arpa_zone(buf, ip, 36);
+		test(strcmp(buf, "0.8.b.d.0.1.0.0.2.ip6.arpa") == 0);
+		ip_fmt_arpa_label(buf, ip, 120);
+		test(strcmp(buf, "b.a") == 0);
+	}
+
+	test_fn("ip_parse_in_addr_arpa");
+	{
+		uint8_t ref[16];
+
+		ip_parse_addr("10.191.10.2", ref);
+		test(ip_parse_in_addr_arpa("2.10.191.10.in-addr.arpa", ip, &mask)
+		  != NULL && mask == 128 && memcmp(ip, ref, 16) == 0);
+		ip_parse_addr("10.191.0.0", ref);
+		test(ip_parse_in_addr_arpa("191.10.in-addr.arpa", ip, &mask)
+		  != NULL && mask == 96 + 16 && memcmp(ip, ref, 16) == 0);
+		test(ip_parse_in_addr_arpa("256.10.in-addr.arpa", ip, &mask) == NULL);
+		test(ip_parse_in_addr_arpa("1.2.3.4.5.in-addr.arpa", ip, &mask) == NULL);
+		test(ip_parse_in_addr_arpa("2.10.191.10.ip6.arpa", ip, &mask) == NULL);
+	}
+
+	test_fn("ip_parse_ip6_arpa");
+	{
+		uint8_t ref[16];
+
+		ip_parse_addr("2001:db8::567:89ab", ref);
+		test(ip_parse_ip6_arpa("b.a.9.8.7.6.5.0.0.0.0.0.0.0.0.0"
+		  ".0.0.0.0.0.0.0.0.8.b.d.0.1.0.0.2.ip6.arpa", ip, &mask) != NULL
+		  && mask == 128 && memcmp(ip, ref, 16) == 0);
+		ip_parse_addr("2001:db8::", ref);
+		test(ip_parse_ip6_arpa("8.B.D.0.1.0.0.2.ip6.arpa", ip, &mask)
+		  != NULL && mask == 32 && memcmp(ip, ref, 16) == 0);
+		test(ip_parse_ip6_arpa("10.0.ip6.arpa", ip, &mask) == NULL);
+		test(ip_parse_ip6_arpa("g.ip6.arpa", ip, &mask) == NULL);
+	}
+}
+
+static void
+test_mac(void)
+{
+	uint8_t mac[6];
+	uint8_t ref[6] = { 0x0c, 0x1c, 0x20, 0xaf, 0xd8, 0xFF };
+	char const *cp;
+
+	test_lib("mac.c");
+
+	test_fn("mac_parse_addr");
+	cp = mac_parse_addr("0c:1c:20:af:d8:ff", mac);
+	test(cp != NULL && *cp == '\0' && memcmp(mac, ref, 6) == 0);
+	cp = mac_parse_addr("0C-1C-20-AF-D8-FF", mac);
+	test(cp != NULL && *cp == '\0' && memcmp(mac, ref, 6) == 0);
+	test(mac_parse_addr("0c:1c:20:af:d8", mac) == NULL);
+	test(mac_parse_addr("0c:1c:20:af:d8:", mac) == NULL);
+	test(mac_parse_addr("0c1c20afd8ff", mac) == NULL);
+	test(mac_parse_addr("", mac) == NULL);
+	test(mac_parse_addr("skynet-router-1", mac) == NULL);
+	cp = mac_parse_addr("0c:1c:20:af:d8:ff:00", mac);
+	test(cp != NULL && *cp == ':');
+
+	test_fn("mac_fmt_addr");
+	{
+		char buf[MAC_FMT_ADDR_LEN];
+
+		mac_fmt_addr(buf, ref);
+		test(strcmp(buf, "0c:1c:20:af:d8:ff") == 0);
+	}
+}
+
+static int
+conf_parse_string(struct conf *conf, char const *s, size_t *ln,
+	struct mem_pool *pool)
+{
+	FILE *fp;
+	int err;
+
+	fp = fmemopen((void *)s, strlen(s), "r");
+	if (fp == NULL)
+		return -CONF_ERR_SYSTEM;
+	err = conf_parse_stream(conf, fp, ln, pool);
+	fclose(fp);
+	return err;
+}
+
+static int
+conf_same(struct conf *a, struct conf *b)
+{
+	size_t n = array_length(&a->sections);
+
+	if (n != array_length(&b->sections) || a->nvariables != b->nvariables
+	 || a->nbytes != b->nbytes)
+		return 0;
+	for (size_t i = 0; i < n; i++) {
+		struct conf_section *sa = array_i(&a->sections, i);
+		struct conf_section *sb = array_i(&b->sections, i);
+		size_t nvars = array_length(&sa->variables);
+
+		if (sa->ln != sb->ln || strcmp(sa->name, sb->name) != 0
+		 || nvars != array_length(&sb->variables))
+			return 0;
+		for (size_t i2 = 0; i2 < nvars; i2++) {
+			struct conf_variable *va = array_i(&sa->variables, i2);
+			struct conf_variable *vb = array_i(&sb->variables, i2);
+
+			if (va->ln != vb->ln || strcmp(va->key, vb->key) != 0
+			 || strcmp(va->value, vb->value) != 0)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static void
+test_conf(void)
+{
+	struct mem_pool pool = {0};
+	struct conf conf;
+	struct conf_section *section;
+	size_t i, ln;
+
+	test_lib("conf.c");
+
+	test_fn("conf_parse_stream");
+	memset(&conf, 0, sizeof conf);
+	test(conf_parse_string(&conf,
+	  "# comment\n"
+	  "[Host]\n"
+	  "  name = skynet-router-1  \n"
+	  "\tip=10.191.10.1\n"
+	  "ip = 10.191.20.1\n"
+	  "\n"
+	  "[host]\n"
+	  "name = skynet-switch-1\n", &ln, &pool) == 0);
+	test(array_length(&conf.sections) == 2);
+	test(conf.nvariables == 4);
+
+	i = 0;
+	section = conf_next_section(&conf, &i, "host");
+	test(section != NULL && section->ln == 2);
+	test(strcmp(section->name, "host") == 0);
+	i = 0;
+	test(strcmp(conf_next_value(section, &i, "name"), "skynet-router-1") == 0);
+	test(strcmp(conf_next_value(section, &i, "ip"), "10.191.10.1") == 0);
+	test(strcmp(conf_next_value(section, &i, "ip"), "10.191.20.1") == 0);
+	test(conf_next_value(section, &i, "ip") == NULL);
+	test(strcmp(conf_get_variable(&conf, "host", "ip"), "10.191.10.1") == 0);
+
+	test_fn("conf_parse_stream (errors)");
+	memset(&conf, 0, sizeof conf);
+	test(conf_parse_string(&conf, "a = b\n", &ln, &pool)
+	  == -CONF_ERR_VARIABLE_BEFORE_SECTION && ln == 1);
+	memset(&conf, 0, sizeof conf);
+	test(conf_parse_string(&conf, "[a]\n\nb\n", &ln, &pool)
+	  == -CONF_ERR_MISSING_EQUAL && ln == 3);
+	memset(&conf, 0, sizeof conf);
+	test(conf_parse_string(&conf, "[a\n", &ln, &pool)
+	  == -CONF_ERR_MISSING_CLOSING_BRACKET);
+	memset(&conf, 0, sizeof conf);
+	test(conf_parse_string(&conf, "[a] b\n", &ln, &pool)
+	  == -CONF_ERR_EXTRA_AFTER_SECTION);
+	memset(&conf, 0, sizeof conf);
+	test(conf_parse_string(&conf, "[a]\n = b\n", &ln, &pool)
+	  == -CONF_ERR_EMPTY_VARIABLE);
+	memset(&conf, 0, sizeof conf);
+	test(conf_parse_string(&conf, "[aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+	  "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa]\n", &ln, &pool)
+	  == -CONF_ERR_SECTION_NAME_TOO_LONG);
+
+	test_fn("conf_parse_file_parallel");
+	{
+		char path[] = "/tmp/netini-test-XXXXXX";
+		struct conf serial = {0};
+		size_t ln2;
+		FILE *fp;
+		int fd;
+
+		/* a few chunks long, with sections not starting a line */
+		test((fd = mkstemp(path)) != -1 && (fp = fdopen(fd, "w")) != NULL);
+		for (int n = 0; n < 60000; n++)
+			fprintf(fp, "# [not a section]\n[host]\nname = host-%d\n"
+			  "ip = 10.%d.%d.%d\n\t[net]\nname = net-%d\n\n", n,
+			  n >> 16 & 0xff, n >> 8 & 0xff, n & 0xff, n);
+		fclose(fp);
+
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_file(&serial, path, &ln, &pool) == 0);
+		test(conf_parse_file_parallel(&conf, path, 4, &ln2, &pool) == 0);
+		test(conf_same(&conf, &serial) && ln == ln2);
+
+		fp = fopen(path, "a");
+		test(fp != NULL);
+		fprintf(fp, "[host]\nbroken\n");
+		fclose(fp);
+
+		memset(&conf, 0, sizeof conf);
+		memset(&serial, 0, sizeof serial);
+		test(conf_parse_file(&serial, path, &ln, &pool) == -CONF_ERR_MISSING_EQUAL);
+		test(conf_parse_file_parallel(&conf, path, 4, &ln2, &pool)
+		  == -CONF_ERR_MISSING_EQUAL && ln == ln2);
+		unlink(path);
+	}
+
+	test_fn("conf_parse_file (gzip)");
+	{
+		/* "[host]\nname = a\nip = 10.0.0.1\n" through gzip -9n */
+		static unsigned char const gz[] = {
+			0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03,
+			0x8b, 0xce, 0xc8, 0x2f, 0x2e, 0x89, 0xe5, 0xca, 0x4b, 0xcc,
+			0x4d, 0x55, 0xb0, 0x55, 0x48, 0xe4, 0xca, 0x2c, 0x00, 0x52,
+			0x86, 0x06, 0x7a, 0x20, 0x68, 0xc8, 0x05, 0x00, 0x42, 0x76,
+			0xc8, 0x73, 0x1e, 0x00, 0x00, 0x00,
+		};
+		char path[] = "/tmp/netini-test-XXXXXX";
+		int fd;
+
+		test((fd = mkstemp(path)) != -1);
+		test(write(fd, gz, sizeof gz) == sizeof gz);
+		test(conf_decompressor(fd) != NULL);
+		close(fd);
+
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_file(&conf, path, &ln, &pool) == 0 && ln == 3);
+		test(strcmp(conf_get_variable(&conf, "host", "ip"), "10.0.0.1") == 0);
+
+		/* cut before the checksum */
+		test(truncate(path, sizeof gz - 8) == 0);
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_file(&conf, path, &ln, &pool) == -CONF_ERR_DECOMPRESS);
+		unlink(path);
+	}
+
+	test_fn("conf_parse_file (include)");
+	{
+		char dir[] = "/tmp/netini-test-XXXXXX", path[64];
+		char const *files[][2] = {
+			{ "sub", NULL },
+			{ "sub/nets.ini", "[net]\nname = lan\nip = 10.0.0.0/8\n" },
+			{ "site.ini", "[host]\nname = h\ninclude = sub/nets.ini\n"
+			  "[host]\nname = i\n" },
+			{ "after.ini", "include = sub/nets.ini\nname = i\n" },
+			{ "loop.ini", "[host]\nInclude=sub/../loop2.ini\n" },
+			{ "loop2.ini", "include = ./loop.ini\n" },
+			{ "twice.ini", "[host]\nname = t\ninclude = sub/nets.ini\n"
+			  "include = site.ini\n" },
+		};
+		size_t nfiles = sizeof files / sizeof *files;
+		struct conf_section *net;
+		struct conf again = {0};
+
+		test(mkdtemp(dir) != NULL);
+		for (size_t i = 0; i < nfiles; i++) {
+			FILE *fp;
+
+			snprintf(path, sizeof path, "%s/%s", dir, files[i][0]);
+			if (files[i][1] == NULL) {
+				mkdir(path, 0700);
+				continue;
+			}
+			if ((fp = fopen(path, "w")) == NULL)
+				continue;
+			fputs(files[i][1], fp);
+			fclose(fp);
+		}
+
+		snprintf(path, sizeof path, "%s/site.ini", dir);
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_file(&conf, path, &ln, &pool) == 0);
+		test(array_length(&conf.sections) == 3);
+		i = 0;
+		net = conf_next_section(&conf, &i, "net");
+		test(net != NULL && i == 2 && net->ln == 3);
+		test(strcmp(conf_get_variable(&conf, "net", "ip"), "10.0.0.0/8") == 0);
+
+		/* the second time comes from the cache */
+		test(conf_parse_file(&again, path, &ln, &pool) == 0);
+		i = 0;
+		test(conf_next_section(&again, &i, "net")->variables.mem
+		  == net->variables.mem);
+
+		/* once in a file, even through another include */
+		snprintf(path, sizeof path, "%s/twice.ini", dir);
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_file(&conf, path, &ln, &pool) == 0);
+		test(array_length(&conf.sections) == 4);
+		i = 0;
+		test(conf_next_section(&conf, &i, "net") != NULL
+		  && conf_next_section(&conf, &i, "net") == NULL);
+
+		/* once in a graph, even from two files */
+		{
+			struct netini_graph graph = {0};
+
+			test(netini_init_graph(&graph, &pool) == 0);
+			test(netini_add_conf(&graph, path, &ln, &pool) == 0);
+			snprintf(path, sizeof path, "%s/site.ini", dir);
+			test(netini_add_conf(&graph, path, &ln, &pool) == 0);
+			test(array_length(&graph.nets) == 1);
+			test(array_length(&graph.hosts) == 3 + 2);
+		}
+
+		snprintf(path, sizeof path, "%s/after.ini", dir);
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_file(&conf, path, &ln, &pool)
+		  == -CONF_ERR_VARIABLE_BEFORE_SECTION && ln == 2);
+
+		snprintf(path, sizeof path, "%s/loop.ini", dir);
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_file(&conf, path, &ln, &pool)
+		  == -CONF_ERR_INCLUDE_CYCLE && ln == 2);
+
+		for (size_t i = nfiles; i > 0; i--) {
+			snprintf(path, sizeof path, "%s/%s", dir, files[i - 1][0]);
+			remove(path);
+		}
+		rmdir(dir);
+	}
+
+	test_fn("conf_dump");
+	{
+		char const *s = "[net]\nname = lan\n\n[host]\nname = h\nip = 10.0.0.1\n";
+		char buf[128] = {0};
+		FILE *fp;
+
+		memset(&conf, 0, sizeof conf);
+		test(conf_parse_string(&conf, s, &ln, &pool) == 0);
+		test((fp = fmemopen(buf, sizeof buf - 1, "w")) != NULL);
+		conf_dump(&conf, fp);
+		fclose(fp);
+		test(strcmp(buf, s) == 0);
+	}
+
+	mem_free(&pool);
+}
+
+static void
+test_mem(void)
+{
+	struct mem_pool pool = {0};
+	struct mem_stats stats;
+	struct array array = {0};
+	int n;
+
+	test_lib("mem.c");
+
+	test_fn("mem_pool_stats");
+	{
+		char *a = mem_alloc(&pool, 10);
+		char *b = mem_alloc(&pool, 20);
+
+		test(mem_resize((void **)&a, 100) == 0);
+		mem_delete(b);
+		mem_pool_stats(&pool, &stats);
+		test(stats.blocks == 1);
+		test(stats.bytes == 100);
+		test(stats.peak == 120);
+		test(stats.allocs == 2);
+		test(stats.resizes == 1);
+		mem_free(&pool);
+		mem_pool_stats(&pool, &stats);
+		test(stats.blocks == 0 && stats.bytes == 0);
+	}
+
+	test_lib("array.c");
+
+	test_fn("array_insert");
+	test(array_init(&array, sizeof n, &pool) == 0);
+	for (n = 0; n < 10; n++)
+		test(array_append(&array, &n) == 0);
+	n = 100;
+	test(array_insert(&array, 0, &n) == 0);
+	test(array_length(&array) == 11);
+	test(*(int *)array_i(&array, 0) == 100);
+	test(*(int *)array_i(&array, 10) == 9);
+
+	test_fn("array_delete");
+	test(array_delete(&array, 0) == 0);
+	test(array_delete(&array, 9) == 0);
+	test(array_length(&array) == 9);
+	test(*(int *)array_i(&array, 0) == 0);
+	test(*(int *)array_i(&array, 8) == 8);
+
+	test_fn("array_concat");
+	{
+		struct array other = {0};
+
+		test(array_init(&other, sizeof n, &pool) == 0);
+		test(array_concat(&array, &other) == 0);
+		test(array_length(&array) == 9);
+		for (n = 20; n < 23; n++)
+			test(array_append(&other, &n) == 0);
+		test(array_concat(&array, &other) == 0);
+		test(array_length(&array) == 12);
+		test(*(int *)array_i(&array, 8) == 8);
+		test(*(int *)array_i(&array, 11) == 22);
+	}
+
+	mem_free(&pool);
+}
+
+static void
+test_hash(void)
+{
+	struct mem_pool pool = {0};
+	struct hash hash = {0};
+	struct hash_entry *entry;
+	char keys[1000][8];
+	size_t i, n;
+	int ok;
+
+	test_lib("hash.c");
+
+	test_fn("hash_set");
+	test(hash_init(&hash, 0, &pool) == 0);
+	ok = 1;
+	for (i = 0; i < 1000; i++) {
+		void **value;
+
+		snprintf(keys[i], sizeof keys[i], "k%zu", i);
+		value = hash_set(&hash, keys[i], strlen(keys[i]));
+		ok = ok && value != NULL && *value == NULL;
+		*value = keys[i];
+	}
+	test(ok);
+	test(hash_length(&hash) == 1000);
+	test(*hash_set(&hash, "k10", 3) == keys[10]);
+	test(hash_length(&hash) == 1000);
+
+	test_fn("hash_get");
+	test(hash_get(&hash, "k999", 4) == keys[999]);
+	test(hash_get(&hash, "k1000", 5) == NULL);
+	test(hash_get(&hash, "k1", 1) == NULL);
+
+	test_fn("hash_next");
+	for (n = 0, i = 0; (entry = hash_next(&hash, &i)) != NULL; n++)
+		continue;
+	test(n == 1000);
+
+	mem_free(&pool);
+}
+
+static int
+load_check(void *arg, char const *path, char *buf, size_t len)
+{
+	size_t *n = arg;
+	char want[2] = { 'a' + (*n)++, '\n' };
+
+	(void)path;
+	return (len == 2 && memcmp(buf, want, 2) == 0) ? 0 : -1;
+}
+
+static void
+test_load(void)
+{
+	struct mem_pool pool = {0};
+	struct array paths = {0};
+	char dir[] = "/tmp/netini-test-XXXXXX", path[64];
+	char const *names[] = { "b.ini", "sub", "sub/c.ini", "sub-d.ini", "a.ini",
+	  "z.txt", ".e.ini", NULL };
+	size_t n = 0, failed;
+
+	test_lib("load.c");
+
+	test_fn("load_expand");
+	test(mkdtemp(dir) != NULL);
+	for (char const **s = names; *s != NULL; s++) {
+		FILE *fp;
+
+		snprintf(path, sizeof path, "%s/%s", dir, *s);
+		if (strcmp(*s, "sub") == 0) {
+			mkdir(path, 0700);
+			continue;
+		}
+		if ((fp = fopen(path, "w")) == NULL)
+			continue;
+		/* the files are listed as a walk of the sorted directories */
+		fprintf(fp, "%c\n", path[strlen(path) - 5]);
+		fclose(fp);
+	}
+	test(array_init(&paths, sizeof(char *), &pool) == 0);
+	test(load_expand(dir, "*.ini", 2, &paths, &pool) == 0);
+	test(array_length(&paths) == 4);
+	test(load_expand(dir, "z*", 2, &paths, &pool) == 0);
+	test(array_length(&paths) == 5);
+	test(strcmp(strrchr(*(char **)array_i(&paths, 4), '/'), "/z.txt") == 0);
+	mem_shrink(&paths.mem, sizeof(char *));
+
+	test_fn("load_files");
+	test(load_files(&paths, 2, load_check, &n, &failed) == 0 && n == 4);
+	n = 1;
+	test(load_files(&paths, 2, load_check, &n, &failed) == -1 && failed == 0);
+
+	test_fn("load_name");
+	test(strcmp(load_name("/var/lib/sw1.example.fdb", &pool), "sw1") == 0);
+	test(strcmp(load_name("sw2", &pool), "sw2") == 0);
+
+	test_fn("load_split");
+	{
+		char line[] = "  lease 10.0.0.1 {\n", *tok[2];
+
+		test(load_split(line, " \t\n{", tok, 2) == 2);
+		test(strcmp(tok[0], "lease") == 0 && strcmp(tok[1], "10.0.0.1") == 0);
+	}
+
+	for (size_t i = sizeof names / sizeof *names - 1; i > 0; i--) {
+		snprintf(path, sizeof path, "%s/%s", dir, names[i - 1]);
+		remove(path);
+	}
+	rmdir(dir);
+	mem_free(&pool);
+}
+
+static void
+test_netini(void)
+{
+	struct mem_pool pool = {0};
+	struct netini_graph graph = {0};
+	struct netini_net *net;
+	char buf[] =
+	  "[net]\nname = a\nip = 10.0.0.0/8\n"
+	  "[net]\nname = b\nip = 10.1.2.0/24\n"
+	  "[net]\nname = c\nip = 10.1.0.0/16\n"
+	  "[net]\nname = d\nip = 192.168.0.0/16\n"
+	  "[net]\nname = e\nip = 10.2.0.0/16\n"
+	  "[host]\nname = h\nip = 10.1.2.3\nip = 10.1.3.1\nip = 172.16.0.1\n";
+	uint8_t ip[16];
+	size_t ln;
+
+	test_lib("netini.c");
+
+	test_fn("netini_net_tree");
+	test(netini_init_graph(&graph, &pool) == 0);
+	test(netini_add_buffer(&graph, buf, strlen(buf), NULL, &ln, &pool) == 0);
+	test(netini_net_tree(&graph) == 0);
+	net = array_i(&graph.nets, 0);
+	test(net->parent == NETINI_NONE && net->child == 2);
+	net = array_i(&graph.nets, 2);
+	test(net->parent == 0 && net->child == 1 && net->next == 4);
+	net = array_i(&graph.nets, 1);
+	test(net->parent == 2 && net->child == NETINI_NONE);
+	net = array_i(&graph.nets, 3);
+	test(net->parent == NETINI_NONE);
+
+	test_fn("netini_find_net");
+	ip_parse_addr("10.1.2.3", ip);
+	test(netini_find_net(&graph, ip) == 1);
+	ip_parse_addr("10.1.3.1", ip);
+	test(netini_find_net(&graph, ip) == 2);
+	ip_parse_addr("10.3.0.0", ip);
+	test(netini_find_net(&graph, ip) == 0);
+	ip_parse_addr("172.16.0.1", ip);
+	test(netini_find_net(&graph, ip) == NETINI_NONE);
+
+	test_fn("netini_add_l3_edges");
+	test(netini_add_l3_edges(&graph) == 0);
+	test(array_length(&graph.edges) == 3 + 2);
+	test(((struct netini_edge *)array_i(&graph.edges, 0))->node[0] == 0);
+	graph.nested = 1;
+	mem_shrink(&graph.edges.mem, 5 * sizeof(struct netini_edge));
+	test(netini_add_l3_edges(&graph) == 0);
+	test(array_length(&graph.edges) == 2 + 3);
+	test(((struct netini_edge *)array_i(&graph.edges, 2))->type == NETINI_E_NET);
+
+	test_fn("netini_load");
+	{
+		char path[] = "/tmp/netini-test-XXXXXX", *argv[] = { path, NULL };
+		struct netini_graph loaded = {0};
+		struct netini_file *file;
+		FILE *fp;
+		int fd;
+
+		test((fd = mkstemp(path)) != -1);
+		test(write(fd, buf, strlen(buf)) == (ssize_t)strlen(buf));
+		close(fd);
+		test(netini_init_graph(&loaded, &pool) == 0);
+		test(netini_load(&loaded, argv, "*.ini", 2, &pool) == 0);
+		test(array_length(&loaded.files) == 1 && array_length(&loaded.nets) == 5);
+		file = array_i(&loaded.files, 0);
+		test(file->path == path && file->host == 0);
+
+		/* the same nets again, without a name for the host */
+		test((fp = fopen(path, "w")) != NULL);
+		fputs("[host]\nip = 10.0.0.1\n", fp);
+		fclose(fp);
+		test(netini_load(&loaded, argv, "*.ini", 2, &pool)
+		  == -NETINI_ERR_MISSING_NAME_VARIABLE);
+		test(loaded.failed.path == path && loaded.failed.ln == 1);
+		unlink(path);
+		test(netini_load(&loaded, argv, "*.ini", 2, &pool) == -1);
+		test(loaded.failed.path == path && loaded.failed.ln == 0);
+	}
+
+	mem_free(&pool);
+}
+
+static void
+test_log(void)
+{
+	test_lib("log.c");
+
+	test_fn("log_num");
+	test(strcmp(fmt(0), "0") == 0);
+	test(strcmp(fmt(7), "7") == 0);
+	test(strcmp(fmt(1234567890), "1234567890") == 0);
+}
+
+TEST_BEGIN
+	test_init();
+	test_log();
+	test_mem();
+	test_hash();
+	test_ip();
+	test_mac();
+	test_conf();
+	test_load();
+	test_netini();
+TEST_END
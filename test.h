@@ -4,7 +4,7 @@
 #include <stdio.h>
 
 #define TEST_BEGIN	int main(void) {
-#define TEST_END	test_summary(); return (0); }
+#define TEST_END	test_summary(); return (test_err > 0); }
 #define test(ok) test_(__LINE__, ok)
 
 static size_t test_count = 0;